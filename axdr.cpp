@@ -0,0 +1,315 @@
+#include "axdr.h"
+#include "dlms/include/errorcodes.h"
+
+//Maximum nesting of arrays and structures.
+#define GX_AXDR_MAX_DEPTH 16
+
+bool CGXAxdr::GetLength(const unsigned char* data, unsigned long size, unsigned long& pos, unsigned long& length)
+{
+    if (pos >= size)
+    {
+        return false;
+    }
+    unsigned char ch = data[pos++];
+    if ((ch & 0x80) == 0)
+    {
+        length = ch;
+        return true;
+    }
+    //Length is given in the next bytes.
+    ch &= 0x7F;
+    if (ch == 0 || ch > 4 || size - pos < ch)
+    {
+        return false;
+    }
+    length = 0;
+    for (; ch != 0; --ch)
+    {
+        length = (length << 8) | data[pos++];
+    }
+    return true;
+}
+
+//Get the size of the fixed length types, -1 for the others.
+static int GXFixedSize(unsigned char type)
+{
+    switch (type)
+    {
+    case 0://Null.
+        return 0;
+    case 3://Boolean.
+    case 13://BCD.
+    case 15://Int8.
+    case 17://UInt8.
+    case 22://Enum.
+    case 28://Delta int8.
+    case 31://Delta uint8.
+        return 1;
+    case 16://Int16.
+    case 18://UInt16.
+    case 29://Delta int16.
+    case 32://Delta uint16.
+        return 2;
+    case 5://Int32.
+    case 6://UInt32.
+    case 23://Float32.
+    case 27://Time.
+    case 30://Delta int32.
+    case 33://Delta uint32.
+        return 4;
+    case 26://Date.
+        return 5;
+    case 20://Int64.
+    case 21://UInt64.
+    case 24://Float64.
+        return 8;
+    case 25://Date-time.
+        return 12;
+    default:
+        return -1;
+    }
+}
+
+//Skip the type description of a compact array.
+static bool GXSkipDescription(const unsigned char* data, unsigned long size, unsigned long& pos, int depth)
+{
+    if (pos >= size || depth > GX_AXDR_MAX_DEPTH)
+    {
+        return false;
+    }
+    unsigned char type = data[pos++];
+    if (type == 1)
+    {
+        //Array: element count and the type of the elements.
+        if (size - pos < 2)
+        {
+            return false;
+        }
+        pos += 2;
+        return GXSkipDescription(data, size, pos, depth + 1);
+    }
+    if (type == 2)
+    {
+        //Structure: the types of the members.
+        unsigned long count;
+        if (!CGXAxdr::GetLength(data, size, pos, count))
+        {
+            return false;
+        }
+        for (; count != 0; --count)
+        {
+            if (!GXSkipDescription(data, size, pos, depth + 1))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    return GXFixedSize(type) != -1 || type == 4 || type == 9 || type == 10 || type == 12;
+}
+
+static bool GXSkip(const unsigned char* data, unsigned long size, unsigned long& pos, int depth)
+{
+    if (pos >= size || depth > GX_AXDR_MAX_DEPTH)
+    {
+        return false;
+    }
+    unsigned char type = data[pos++];
+    unsigned long length;
+    int fixed = GXFixedSize(type);
+    if (fixed != -1)
+    {
+        if (size - pos < (unsigned long)fixed)
+        {
+            return false;
+        }
+        pos += fixed;
+        return true;
+    }
+    switch (type)
+    {
+    case 1://Array.
+    case 2://Structure.
+        if (!CGXAxdr::GetLength(data, size, pos, length))
+        {
+            return false;
+        }
+        for (; length != 0; --length)
+        {
+            if (!GXSkip(data, size, pos, depth + 1))
+            {
+                return false;
+            }
+        }
+        return true;
+    case 4://Bit string, the length is in bits.
+        if (!CGXAxdr::GetLength(data, size, pos, length))
+        {
+            return false;
+        }
+        length = (length + 7) / 8;
+        break;
+    case 9://Octet string.
+    case 10://Visible string.
+    case 12://UTF-8 string.
+        if (!CGXAxdr::GetLength(data, size, pos, length))
+        {
+            return false;
+        }
+        break;
+    case 19://Compact array, type description and the size of the contents in bytes.
+        if (!GXSkipDescription(data, size, pos, depth + 1) ||
+            !CGXAxdr::GetLength(data, size, pos, length))
+        {
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+    if (size - pos < length)
+    {
+        return false;
+    }
+    pos += length;
+    return true;
+}
+
+bool CGXAxdr::Skip(const unsigned char* data, unsigned long size, unsigned long& pos)
+{
+    return GXSkip(data, size, pos, 0);
+}
+
+void CGXAxdr::SetLength(unsigned long length, std::string& data)
+{
+    if (length < 0x80)
+    {
+        data.push_back((char)length);
+        return;
+    }
+    int count = length < 0x100 ? 1 : (length < 0x10000 ? 2 : (length < 0x1000000 ? 3 : 4));
+    data.push_back((char)(0x80 | count));
+    for (int i = count - 1; i >= 0; --i)
+    {
+        data.push_back((char)(length >> (8 * i)));
+    }
+}
+
+bool CGXAxdr::GetRows(const unsigned char* data, unsigned long size, std::vector<unsigned long>& rows)
+{
+    unsigned long pos = 0, count;
+    rows.clear();
+    if (size == 0 || data[pos++] != 1 || !GetLength(data, size, pos, count))
+    {
+        return false;
+    }
+    for (; count != 0; --count)
+    {
+        rows.push_back(pos);
+        if (!GXSkip(data, size, pos, 1))
+        {
+            return false;
+        }
+    }
+    return pos == size;
+}
+
+bool CGXAxdr::SplitList(const unsigned char* data, unsigned long size, unsigned long count,
+    std::vector<std::string>& values, std::vector<int>& errors)
+{
+    unsigned long pos = 0, length;
+    values.clear();
+    errors.clear();
+    if (!GetLength(data, size, pos, length) || length != count)
+    {
+        return false;
+    }
+    for (; length != 0; --length)
+    {
+        if (pos >= size)
+        {
+            return false;
+        }
+        unsigned char choice = data[pos++];
+        if (choice == 0)
+        {
+            unsigned long start = pos;
+            if (!Skip(data, size, pos))
+            {
+                return false;
+            }
+            values.push_back(std::string((const char*)data + start, pos - start));
+            errors.push_back(0);
+        }
+        else if (choice == 1)
+        {
+            //Data access result.
+            if (pos >= size)
+            {
+                return false;
+            }
+            values.push_back(std::string());
+            //Success is not a valid reason to fail, it is taken as other reason.
+            errors.push_back(data[pos] == 0 ? 250 : data[pos]);
+            ++pos;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    //Nothing may follow the last result.
+    return pos == size;
+}
+
+CGXRowReader::CGXRowReader(CGXRowSink& sink) : m_Sink(sink), m_Position(0), m_Start(0), m_Count(0), m_Rows(0)
+{
+}
+
+int CGXRowReader::Feed(const unsigned char* data, unsigned long size)
+{
+    int ret;
+    if (m_Position == 0)
+    {
+        unsigned long pos = 1;
+        if (size == 0)
+        {
+            return 0;
+        }
+        if (data[0] != 1)
+        {
+            return DLMS_ERROR_CODE_INVALID_RESPONSE;
+        }
+        //Count is not received yet.
+        if (!CGXAxdr::GetLength(data, size, pos, m_Count))
+        {
+            return 0;
+        }
+        m_Position = pos;
+        m_Start = pos;
+    }
+    while (m_Rows != m_Count)
+    {
+        //A row which is not complete is walked again when the next block has arrived.
+        unsigned long pos = m_Position;
+        if (!GXSkip(data, size, pos, 1))
+        {
+            break;
+        }
+        if ((ret = m_Sink.OnRow(data + m_Position, pos - m_Position)) != 0)
+        {
+            return ret;
+        }
+        m_Position = pos;
+        ++m_Rows;
+    }
+    return 0;
+}
+
+unsigned long CGXRowReader::Release(unsigned long& start)
+{
+    unsigned long size = m_Position - m_Start;
+    start = m_Start;
+    m_Position = m_Start;
+    return size;
+}
@@ -0,0 +1,80 @@
+#ifndef GXAXDR_H
+#define GXAXDR_H
+
+#include <string>
+#include <vector>
+
+//Walks A-XDR encoded data (IEC 62056-6-2) without decoding it,
+//so the raw encoding of each value can be handed out as it was received.
+class CGXAxdr
+{
+public:
+    //Get a length or an element count. Returns false if the data ends.
+    static bool GetLength(const unsigned char* data, unsigned long size, unsigned long& pos, unsigned long& length);
+
+    //Skip one encoded value, including its data type.
+    //Returns false if the value is not complete or the type is unknown.
+    static bool Skip(const unsigned char* data, unsigned long size, unsigned long& pos);
+
+    //Append a length or an element count.
+    static void SetLength(unsigned long length, std::string& data);
+
+    //Get the position of each element of an array, like the rows of a profile buffer.
+    //Returns false if the data is not a complete array.
+    static bool GetRows(const unsigned char* data, unsigned long size, std::vector<unsigned long>& rows);
+
+    //Split the result list of a GET-with-list response into raw values.
+    //The list starts with the result count, each result is either a value or a
+    //data access result. Values of failed results are empty and their error is
+    //set, the error of a read value is 0.
+    //Returns false if the data is not a complete list of count results.
+    static bool SplitList(const unsigned char* data, unsigned long size, unsigned long count,
+        std::vector<std::string>& values, std::vector<int>& errors);
+};
+
+//Receives the rows of an array as they are decoded.
+class CGXRowSink
+{
+public:
+    virtual ~CGXRowSink()
+    {
+    }
+
+    //Called with the raw encoding of each complete row.
+    //A return value other than 0 stops the read with that error.
+    virtual int OnRow(const unsigned char* data, unsigned long size) = 0;
+};
+
+//Decodes an array, like the buffer of a profile, while its blocks arrive.
+//Each row is handed to the sink as soon as it is complete.
+class CGXRowReader
+{
+    CGXRowSink& m_Sink;
+    //Position of the next row, 0 until the array header is read.
+    unsigned long m_Position;
+    //Position of the first row, after the array header.
+    unsigned long m_Start;
+    //Number of rows in the array and the rows handed out.
+    unsigned long m_Count;
+    unsigned long m_Rows;
+public:
+    CGXRowReader(CGXRowSink& sink);
+
+    //Hand out the rows which are complete in the data received so far.
+    //The data starts at the array header and grows with each block, without
+    //the rows which were released.
+    int Feed(const unsigned char* data, unsigned long size);
+
+    //Get the rows handed out, which the caller may drop from its data. They
+    //start after the array header, the rows after them move to their place.
+    //Returns the size of the rows.
+    unsigned long Release(unsigned long& start);
+
+    //Are all rows of the array handed out.
+    bool IsComplete() const
+    {
+        return m_Position != 0 && m_Rows == m_Count;
+    }
+};
+
+#endif //GXAXDR_H
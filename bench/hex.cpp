@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "../hex.h"
+
+/* Bytes per second of the hex of a profile dump, the snprintf loop against CGXHex. */
+#define BENCH_SIZE (1 << 20)
+#define BENCH_ROUNDS 64
+
+static double bench_seconds(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+	std::vector<unsigned char> data(BENCH_SIZE);
+	std::string a, b;
+	char hex[3];
+
+	for(size_t i = 0; i < data.size(); i++) {
+		data[i] = (unsigned char)rand();
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int r = 0; r < BENCH_ROUNDS; r++) {
+		a.clear();
+		for(size_t i = 0; i < data.size(); i++) {
+			snprintf(hex, sizeof(hex), "%02X", data[i]);
+			a.append(hex, 2);
+		}
+	}
+	double loop = bench_seconds(start);
+
+	start = std::chrono::steady_clock::now();
+	for(int r = 0; r < BENCH_ROUNDS; r++) {
+		b.clear();
+		CGXHex::Append(data.data(), data.size(), b);
+	}
+	double simd = bench_seconds(start);
+
+	if(a != b) {
+		fprintf(stderr, "The hex doesn't match\n");
+		return 1;
+	}
+	double bytes = (double)BENCH_SIZE * BENCH_ROUNDS;
+	printf("snprintf: %8.1f MB/s\n", bytes / loop / 1e6);
+	printf("CGXHex:   %8.1f MB/s\n", bytes / simd / 1e6);
+	return 0;
+}
@@ -33,11 +33,15 @@
 //---------------------------------------------------------------------------
 
 #include "communication.h"
+#include "axdr.h"
+#include "state.h"
 #include "dlms/include/GXDLMSConverter.h"
 #include "dlms/include/GXDLMSProfileGeneric.h"
 #include "dlms/include/GXDLMSDemandRegister.h"
 #include "dlms/include/GXDLMSTranslator.h"
 #include "dlms/include/GXDLMSData.h"
+#include "serial.h"
+#include "connector.h"
 
 void CGXCommunication::WriteValue(GX_TRACE_LEVEL trace, std::string line)
 {
@@ -46,7 +50,9 @@ void CGXCommunication::WriteValue(GX_TRACE_LEVEL trace, std::string line)
 
 CGXCommunication::CGXCommunication(CGXDLMSSecureClient* pParser, int wt, GX_TRACE_LEVEL trace, char* invocationCounter) :
     m_WaitTime(wt), m_Parser(pParser),
-    m_socket(-1), m_Trace(trace), m_InvocationCounter(invocationCounter)
+    m_socket(-1), m_Trace(trace), m_InvocationCounter(invocationCounter), m_Final(true),
+    m_Iec(false), m_MaxBaudrate(19200), m_Port(0), m_Baudrate(0), m_Speed(0), m_Direct(false), m_LinkUp(false), m_RetryInThread(true),
+    m_CounterKnown(false), m_Block(false), m_Select(false), m_Rows(NULL)
 {
 #if defined(_WIN32) || defined(_WIN64)//Windows includes
     ZeroMemory(&m_osReader, sizeof(OVERLAPPED));
@@ -104,10 +110,9 @@ int CGXCommunication::Close()
     int ret;
     std::vector<CGXByteBuffer> data;
     CGXReplyData reply;
-    /*
+    //The wrapper has no link layer, the association is released instead.
     if ((m_hComPort != INVALID_HANDLE_VALUE || m_socket != -1) &&
-        (m_Parser->GetInterfaceType() == DLMS_INTERFACE_TYPE_WRAPPER ||
-            m_Parser->GetCiphering()->GetSecurity() != DLMS_SECURITY_NONE))
+        m_Parser->GetInterfaceType() == DLMS_INTERFACE_TYPE_WRAPPER)
     {
         if ((ret = m_Parser->ReleaseRequest(data)) != 0 ||
             (ret = ReadDataBlock(data, reply)) != 0)
@@ -116,8 +121,7 @@ int CGXCommunication::Close()
             fprintf(stderr, "ReleaseRequest failed (%d) %s.\r\n", ret, CGXDLMSConverter::GetErrorMessage(ret));
         }
     }
-    */
-    if (m_hComPort != INVALID_HANDLE_VALUE || m_socket != -1)
+    else if (m_hComPort != INVALID_HANDLE_VALUE || m_socket != -1)
     {
         if ((ret = m_Parser->DisconnectRequest(data)) != 0 ||
             (ret = ReadDataBlock(data, reply)) != 0)
@@ -126,16 +130,30 @@ int CGXCommunication::Close()
             fprintf(stderr, "DisconnectRequest failed (%d) %s.\r\n", ret, CGXDLMSConverter::GetErrorMessage(ret));
         }
     }
+    SaveState();
+#if defined(_WIN32) || defined(_WIN64)//Windows includes
     if (m_hComPort != INVALID_HANDLE_VALUE)
     {
-#if defined(_WIN32) || defined(_WIN64)//Windows includes
-        CloseHandle(m_hComPort);
         CloseHandle(m_osReader.hEvent);
         CloseHandle(m_osWrite.hEvent);
+    }
+#endif
+    CloseMedia();
+    return 0;
+}
+
+//Close the serial port or the socket without a disconnect request.
+void CGXCommunication::CloseMedia()
+{
+    if (m_hComPort != INVALID_HANDLE_VALUE)
+    {
+#if defined(_WIN32) || defined(_WIN64)//Windows includes
+        CloseHandle(m_hComPort);
 #else
         close(m_hComPort);
 #endif
         m_hComPort = INVALID_HANDLE_VALUE;
+        m_Assembler.Reset();
     }
     if (m_socket != -1)
     {
@@ -147,37 +165,30 @@ int CGXCommunication::Close()
 #endif
         m_socket = -1;
     }
-    return 0;
-}
-
-bool IsIPv6Address(const char* pAddress)
-{
-    return strstr(pAddress, ":") != NULL;
 }
 
 //Make TCP/IP connection to the meter.
 int CGXCommunication::Connect(const char* pAddress, unsigned short Port)
 {
-    int ret;
+    int ret, s;
     Close();
-    //create socket.
-    int family = IsIPv6Address(pAddress) ? AF_INET6 : AF_INET;
-#if defined ( _WIN32 ) || defined ( _WIN64 )
-    WSADATA wsaData;
-    // Initialize Winsock
-    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != NO_ERROR) {
-        return DLMS_ERROR_CODE_INVALID_PARAMETER;
-    }
-#endif
-    m_socket = socket(family, SOCK_STREAM, IPPROTO_IP);
-    if (m_socket == -1)
+    if ((ret = CGXConnector::Connect(pAddress, Port, m_WaitTime, s)) != 0)
     {
-#if defined ( _WIN32 ) || defined ( _WIN64 )
-        WSACleanup();
-#endif
-//        assert(0);
+        fprintf(stderr, "Connect to %s failed %d.\r\n", pAddress, ret);
         return DLMS_ERROR_CODE_INVALID_PARAMETER;
     }
+    return Attach(s, pAddress, Port);
+}
+
+//Use a socket which is already connected to the meter.
+int CGXCommunication::Attach(int socket, const char* pAddress, unsigned short port)
+{
+    Close();
+    LoadRtt();
+    m_Settings.clear();
+    m_Host = pAddress;
+    m_Port = port;
+    m_socket = socket;
 #if defined ( _WIN32 ) || defined ( _WIN64 )
     int timeout = this->m_WaitTime;
     setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(int));
@@ -189,56 +200,6 @@ int CGXCommunication::Connect(const char* pAddress, unsigned short Port)
     setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
     setsockopt(m_socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
 #endif
-    sockaddr* add;
-    int addSize;
-    sockaddr_in6 addrIP6;
-    sockaddr_in addIP4;
-    if (family == AF_INET)
-    {
-        addIP4.sin_port = htons(Port);
-        addIP4.sin_family = AF_INET;
-        addIP4.sin_addr.s_addr = inet_addr(pAddress);
-        //If address is give as name
-        if (addIP4.sin_addr.s_addr == INADDR_NONE)
-        {
-            hostent* Hostent = gethostbyname(pAddress);
-            if (Hostent == NULL)
-            {
-#if defined(_WIN32) || defined(_WIN64)//If Windows
-                int err = WSAGetLastError();
-#else
-                int err = errno;
-#endif
-                Close();
-                return err;
-            };
-            addIP4.sin_addr = *(in_addr*)(void*)Hostent->h_addr_list[0];
-            add = (sockaddr*)&addIP4;
-            addSize = sizeof(sockaddr_in);
-        };
-    }
-    else
-    {
-        memset(&addrIP6, 0, sizeof(sockaddr_in6));
-        addrIP6.sin6_port = htons(Port);
-        addrIP6.sin6_family = AF_INET6;
-//        ret = inet_pton(family, pAddress, &(addrIP6.sin6_addr));
-#warning inet_pton() doesn't support currently.
-        ret = -1;
-        if (ret == -1)
-        {
-            return DLMS_ERROR_CODE_INVALID_PARAMETER;
-        };
-        add = (sockaddr*)&addrIP6;
-        addSize = sizeof(sockaddr_in6);
-    }
-
-    //Connect to the meter.
-    ret = connect(m_socket, add, addSize);
-    if (ret == -1)
-    {
-        return DLMS_ERROR_CODE_INVALID_PARAMETER;
-    };
     return DLMS_ERROR_CODE_OK;
 }
 
@@ -307,114 +268,162 @@ int CGXCommunication::GXSetCommState(HANDLE hWnd, LPDCB DCB)
 
 #endif //Windows
 
-int CGXCommunication::Read(unsigned char eop, CGXByteBuffer& reply)
+#if !defined(_WIN32) && !defined(_WIN64)//If Linux.
+//Wait until data is available or the deadline has elapsed.
+int CGXCommunication::WaitForData(int fd, long long deadline)
+{
+    int ret;
+    long long left;
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    for (;;)
+    {
+        left = deadline - Monotonic();
+        if (left <= 0)
+        {
+            return DLMS_ERROR_CODE_RECEIVE_FAILED;
+        }
+        pfd.revents = 0;
+        ret = poll(&pfd, 1, (int)left);
+        if (ret > 0)
+        {
+            //Read pending data even if the other side has hung up.
+            if (pfd.revents & POLLIN)
+            {
+                return DLMS_ERROR_CODE_OK;
+            }
+            return DLMS_ERROR_CODE_RECEIVE_FAILED;
+        }
+        if (ret == 0 || errno != EINTR)
+        {
+            return DLMS_ERROR_CODE_RECEIVE_FAILED;
+        }
+    }
+}
+#endif
+
+//Read bytes which are available, wait for the first one until the deadline.
+int CGXCommunication::ReadAvailable(long long deadline, int& count)
 {
 #if defined(_WIN32) || defined(_WIN64)//Windows
     unsigned long RecieveErrors;
     COMSTAT comstat;
     DWORD bytesRead = 0;
+    long long left;
 #else //If Linux.
-    unsigned short bytesRead = 0;
-    int ret, readTime = 0;
+    int ret;
 #endif
-    int pos;
     unsigned long cnt = 1;
-    bool bFound = false;
-    int lastReadIndex = reply.GetPosition();
-    do
-    {
+    count = 0;
 #if defined(_WIN32) || defined(_WIN64)//Windows
-        //We do not want to read byte at the time.
-        if (!ClearCommError(m_hComPort, &RecieveErrors, &comstat))
-        {
-            return DLMS_ERROR_CODE_SEND_FAILED;
-        }
-        bytesRead = 0;
-        cnt = 1;
-        //Try to read at least one byte.
-        if (comstat.cbInQue > 0)
+    //We do not want to read byte at the time.
+    if (!ClearCommError(m_hComPort, &RecieveErrors, &comstat))
+    {
+        return DLMS_ERROR_CODE_SEND_FAILED;
+    }
+    cnt = 1;
+    //Try to read at least one byte.
+    if (comstat.cbInQue > 0)
+    {
+        cnt = comstat.cbInQue;
+    }
+    //If there is more data than can fit to buffer.
+    if (cnt > RECEIVE_BUFFER_SIZE)
+    {
+        cnt = RECEIVE_BUFFER_SIZE;
+    }
+    if (!ReadFile(m_hComPort, m_Receivebuff, cnt, &bytesRead, &m_osReader))
+    {
+        DWORD nErr = GetLastError();
+        if (nErr != ERROR_IO_PENDING)
         {
-            cnt = comstat.cbInQue;
+            return DLMS_ERROR_CODE_RECEIVE_FAILED;
         }
-        //If there is more data than can fit to buffer.
-        if (cnt > RECEIVE_BUFFER_SIZE)
+        left = deadline - Monotonic();
+        //Wait until data is actually read
+        if (left <= 0 || ::WaitForSingleObject(m_osReader.hEvent, (DWORD)left) != WAIT_OBJECT_0)
         {
-            cnt = RECEIVE_BUFFER_SIZE;
+            return DLMS_ERROR_CODE_RECEIVE_FAILED;
         }
-        if (!ReadFile(m_hComPort, m_Receivebuff, cnt, &bytesRead, &m_osReader))
+        if (!GetOverlappedResult(m_hComPort, &m_osReader, &bytesRead, TRUE))
         {
-            DWORD nErr = GetLastError();
-            if (nErr != ERROR_IO_PENDING)
-            {
-                return DLMS_ERROR_CODE_RECEIVE_FAILED;
-            }
-            //Wait until data is actually read
-            if (::WaitForSingleObject(m_osReader.hEvent, m_WaitTime) != WAIT_OBJECT_0)
-            {
-                return DLMS_ERROR_CODE_RECEIVE_FAILED;
-            }
-            if (!GetOverlappedResult(m_hComPort, &m_osReader, &bytesRead, TRUE))
-            {
-                return DLMS_ERROR_CODE_RECEIVE_FAILED;
-            }
+            return DLMS_ERROR_CODE_RECEIVE_FAILED;
         }
+    }
+    count = (int)bytesRead;
+    //Note! Some USB converters can return true for ReadFile and Zero as bytesRead.
+    //In that case wait for a while and read again.
+    if (count == 0)
+    {
+        Sleep(100);
+    }
 #else
-        //Get bytes available.
-        ret = ioctl(m_hComPort, FIONREAD, &cnt);
-        //If driver is not supporting this functionality.
-        if (ret < 0)
+    //Sleep until the first byte arrives, not longer than the wait time.
+    if (WaitForData(m_hComPort, deadline) != DLMS_ERROR_CODE_OK)
+    {
+        fprintf(stderr, "Read failed. Timeout occurred.\r\n");
+        return DLMS_ERROR_CODE_RECEIVE_FAILED;
+    }
+    //Get bytes available.
+    ret = ioctl(m_hComPort, FIONREAD, &cnt);
+    //If driver is not supporting this functionality.
+    if (ret < 0)
+    {
+        cnt = RECEIVE_BUFFER_SIZE;
+    }
+    else if (cnt == 0)
+    {
+        //Try to read at least one byte.
+        cnt = 1;
+    }
+    //If there is more data than can fit to buffer.
+    if (cnt > RECEIVE_BUFFER_SIZE)
+    {
+        cnt = RECEIVE_BUFFER_SIZE;
+    }
+    count = read(m_hComPort, m_Receivebuff, cnt);
+    if (count == -1)
+    {
+        count = 0;
+        //Spurious wake up, wait again.
+        if (errno == EAGAIN || errno == EINTR)
         {
-            cnt = RECEIVE_BUFFER_SIZE;
+            return DLMS_ERROR_CODE_OK;
         }
-        else if (cnt == 0)
+        //If connection is closed.
+        else if (errno == EBADF)
         {
-            //Try to read at least one byte.
-            cnt = 1;
+            fprintf(stderr, "Read failed. Connection closed.\r\n");
+            return DLMS_ERROR_CODE_RECEIVE_FAILED;
         }
-        //If there is more data than can fit to buffer.
-        if (cnt > RECEIVE_BUFFER_SIZE)
+        else
         {
-            cnt = RECEIVE_BUFFER_SIZE;
+            fprintf(stderr, "Read failed. %d.\r\n", errno);
+            return DLMS_ERROR_CODE_RECEIVE_FAILED;
         }
-        bytesRead = read(m_hComPort, m_Receivebuff, cnt);
-        if (bytesRead == 0xFFFF)
+    }
+#endif
+    return DLMS_ERROR_CODE_OK;
+}
+
+int CGXCommunication::Read(unsigned char eop, CGXByteBuffer& reply)
+{
+    int ret, pos, count;
+    bool bFound = false;
+    int lastReadIndex = reply.GetPosition();
+    long long deadline = Monotonic() + m_WaitTime;
+    do
+    {
+        if ((ret = ReadAvailable(deadline, count)) != DLMS_ERROR_CODE_OK)
         {
-            //If wait time has elapsed.
-            if (errno == EAGAIN)
-            {
-                if (readTime > m_WaitTime)
-                {
-                    fprintf(stderr, "Read failed. Timeout occurred.\r\n");
-                    return DLMS_ERROR_CODE_RECEIVE_FAILED;
-                }
-                readTime += 100;
-                bytesRead = 0;
-            }
-            //If connection is closed.
-            else if (errno == EBADF)
-            {
-                fprintf(stderr, "Read failed. Connection closed.\r\n");
-                return DLMS_ERROR_CODE_RECEIVE_FAILED;
-            }
-            else
-            {
-                fprintf(stderr, "Read failed. %d.\r\n", errno);
-                return DLMS_ERROR_CODE_RECEIVE_FAILED;
-            }
+            return ret;
         }
-#endif
-        reply.Set(m_Receivebuff, bytesRead);
-        //Note! Some USB converters can return true for ReadFile and Zero as bytesRead.
-        //In that case wait for a while and read again.
-        if (bytesRead == 0)
+        if (count == 0)
         {
-#if defined(_WIN32) || defined(_WIN64)//Windows
-            Sleep(100);
-#else
-            usleep(100000);
-#endif
             continue;
         }
+        reply.Set(m_Receivebuff, count);
         if (reply.GetSize() > 5)
         {
             //Some optical strobes can return extra bytes.
@@ -426,17 +435,135 @@ int CGXCommunication::Read(unsigned char eop, CGXByteBuffer& reply)
                     break;
                 }
             }
-            lastReadIndex = pos;
+            //Bytes before the new chunk are not scanned again.
+            lastReadIndex = bFound ? pos : reply.GetSize() - 1;
         }
     } while (!bFound);
     return DLMS_ERROR_CODE_OK;
 }
 
+//Read next valid HDLC frame.
+long CGXCommunication::GetFrameTime()
+{
+    //Flags, address, control and check bytes around the information field, 11 bits for each byte.
+    unsigned long size = m_Parser->GetHdlcSettings().GetMaxInfoRX() + 16;
+    unsigned long speed = m_Speed == 0 ? 300 : m_Speed;
+    return (long)(size * 11 * 1000 / speed);
+}
+
+int CGXCommunication::ReadFrame(CGXByteBuffer& reply, long timeout)
+{
+    int ret, count;
+    unsigned long dropped = m_Assembler.Dropped();
+    std::vector<unsigned char> frame;
+    long long deadline = Monotonic() + timeout;
+    //A line which keeps sending bytes doesn't move the wait on for ever. The frame must
+    //arrive within the wait time and the time the largest frame takes at the line speed.
+    long long limit = Monotonic() + m_WaitTime + GetFrameTime();
+    while (!m_Assembler.Pop(frame))
+    {
+        if ((ret = ReadAvailable(deadline, count)) != DLMS_ERROR_CODE_OK)
+        {
+            return ret;
+        }
+        if (count != 0)
+        {
+            //Frame is still coming.
+            deadline = Monotonic() + timeout;
+            if (deadline > limit)
+            {
+                deadline = limit;
+            }
+        }
+        m_Assembler.Push(m_Receivebuff, count);
+    }
+    if (m_Assembler.Dropped() != dropped)
+    {
+        fprintf(stderr, "%lu corrupted HDLC frames dropped.\r\n", m_Assembler.Dropped() - dropped);
+    }
+    m_Final = (CGXHdlcAssembler::GetControl(frame) & HDLC_FRAME_FINAL) != 0;
+    reply.Set(&frame[0], (unsigned long)frame.size());
+    return DLMS_ERROR_CODE_OK;
+}
+
+#if !defined(_WIN32) && !defined(_WIN64)//If Linux
+//Get the termios constant of a baud rate, B0 if there is none.
+static speed_t GXGetSpeed(unsigned long baudRate)
+{
+    switch (baudRate)
+    {
+    case 300:
+        return B300;
+    case 600:
+        return B600;
+    case 1200:
+        return B1200;
+    case 2400:
+        return B2400;
+    case 4800:
+        return B4800;
+    case 9600:
+        return B9600;
+    case 19200:
+        return B19200;
+    case 38400:
+        return B38400;
+    case 57600:
+        return B57600;
+    case 115200:
+        return B115200;
+    case 230400:
+        return B230400;
+#ifdef B460800
+    case 460800:
+        return B460800;
+#endif
+#ifdef B921600
+    case 921600:
+        return B921600;
+#endif
+    default:
+        return B0;
+    }
+}
+#endif
+
 //Open serial port.
 int CGXCommunication::Open(const char* settings, bool iec, int maxBaudrate)
 {
     Close();
-    unsigned short baudRate;
+    m_Host.clear();
+    m_Settings = settings;
+    m_Iec = iec;
+    m_MaxBaudrate = maxBaudrate;
+    m_Direct = false;
+    m_Ident.clear();
+    m_Baudrate = 0;
+    LoadRtt();
+    if (iec && LoadState() && GetState("cap.direct") != "0" && !GetState("cap.baud").empty())
+    {
+        //Known meter, the port is opened with the settings of mode E.
+        std::string port = m_Settings;
+        std::vector< std::string > tmp = GXHelpers::Split(port, ':');
+        std::string direct = tmp[0] + ":" + GetState("cap.baud") + ":8None1";
+        if (tmp.size() > 3)
+        {
+            direct += ":" + tmp[3];
+        }
+        if (OpenPort(direct.c_str(), false, maxBaudrate) == DLMS_ERROR_CODE_OK)
+        {
+            m_Direct = true;
+            return DLMS_ERROR_CODE_OK;
+        }
+        Close();
+    }
+    return OpenPort(settings, iec, maxBaudrate);
+}
+
+int CGXCommunication::OpenPort(const char* settings, bool iec, int maxBaudrate)
+{
+    unsigned long baudRate;
+    bool lowLatency = false;
 #if defined(_WIN32) || defined(_WIN64)
     unsigned char parity;
 #else //Linux
@@ -500,6 +627,19 @@ int CGXCommunication::Open(const char* settings, bool iec, int maxBaudrate)
             return DLMS_ERROR_CODE_INVALID_PARAMETER;
         }
         stopBits = atoi(tmp[2].substr(tmp[2].size() - 1, 1).c_str());
+        //Optional serial profile.
+        if (tmp.size() > 3)
+        {
+            if (tmp[3].compare("lowlatency") == 0)
+            {
+                lowLatency = true;
+            }
+            else
+            {
+                fprintf(stderr, "Invalid serial profile :\"%s\"\r\n", tmp[3].c_str());
+                return DLMS_ERROR_CODE_INVALID_PARAMETER;
+            }
+        }
     }
     else
     {
@@ -508,12 +648,14 @@ int CGXCommunication::Open(const char* settings, bool iec, int maxBaudrate)
         parity = NOPARITY;
         stopBits = ONESTOPBIT;
 #else
-        baudRate = B9600;
+        baudRate = 9600;
         parity = 0;
         stopBits = 0;
 #endif
         dataBits = 8;
     }
+    //Mode E starts at 300 baud.
+    m_Speed = iec ? 300 : baudRate;
 
     CGXByteBuffer reply;
     int ret, len, pos;
@@ -585,6 +727,7 @@ int CGXCommunication::Open(const char* settings, bool iec, int maxBaudrate)
     }
 #else //#if defined(__LINUX__)
     struct termios options;
+    speed_t speed = B0;
     // read/write | not controlling term | don't wait for DCD line signal.
     m_hComPort = open(port.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
     if (m_hComPort == -1) // if open is unsuccessful.
@@ -599,6 +742,11 @@ int CGXCommunication::Open(const char* settings, bool iec, int maxBaudrate)
             fprintf(stderr, "Failed to Open port. This is not a serial port.\r\n");
             return DLMS_ERROR_CODE_INVALID_PARAMETER;
         }
+        //It's ok if the driver doesn't support this.
+        if (lowLatency && GXSetLowLatency(m_hComPort, true) != 0)
+        {
+            fprintf(stderr, "Low latency mode is not supported by the serial driver.\r\n");
+        }
         memset(&options, 0, sizeof(options));
         options.c_iflag = 0;
         options.c_oflag = 0;
@@ -625,8 +773,9 @@ int CGXCommunication::Open(const char* settings, bool iec, int maxBaudrate)
             options.c_cflag |= CS8;
             */
             //Set Baud Rates
-            cfsetospeed(&options, B9600);
-            cfsetispeed(&options, B9600);
+            speed = GXGetSpeed(baudRate);
+            cfsetospeed(&options, speed == B0 ? B9600 : speed);
+            cfsetispeed(&options, speed == B0 ? B9600 : speed);
         }
         options.c_lflag = 0;
         options.c_cc[VMIN] = 1;
@@ -639,6 +788,12 @@ int CGXCommunication::Open(const char* settings, bool iec, int maxBaudrate)
             fprintf(stderr, "Failed to Open port. tcsetattr failed.\r\n");
             return DLMS_ERROR_CODE_INVALID_PARAMETER;
         }
+        //Baud rate without Bxxx constant.
+        if (!iec && speed == B0 && GXSetCustomBaudRate(m_hComPort, baudRate) != 0)
+        {
+            fprintf(stderr, "Failed to Open port. Baud rate %lu is not supported.\r\n", baudRate);
+            return DLMS_ERROR_CODE_INVALID_PARAMETER;
+        }
     }
 #endif
     if (iec)
@@ -721,65 +876,31 @@ int CGXCommunication::Open(const char* settings, bool iec, int maxBaudrate)
             }
             return DLMS_ERROR_CODE_SEND_FAILED;
         }
+        //Keep the identification, without the line end.
+        m_Ident.assign((const char*)reply.GetData() + reply.GetPosition() - 1, reply.GetSize() - reply.GetPosition() + 1);
+        while (!m_Ident.empty() && (m_Ident[m_Ident.size() - 1] == '\r' || m_Ident[m_Ident.size() - 1] == '\n'))
+        {
+            m_Ident.erase(m_Ident.size() - 1);
+        }
         //Get used baud rate.
         if ((ret = reply.GetUInt8(reply.GetPosition() + 3, &ch)) != 0)
         {
             return DLMS_ERROR_CODE_SEND_FAILED;
         }
-        switch (ch)
+        //Baud rates of the IEC 62056-21 baud rate characters.
+        static const unsigned long IEC_BAUD_RATES[] = { 300, 600, 1200, 2400, 4800, 9600, 19200 };
+        if (ch < '0' || ch > '6')
         {
-        case '0':
-#if defined(_WIN32) || defined(_WIN64)
-            baudRate = 300;
-#else
-            baudRate = B300;
-#endif
-            break;
-        case '1':
-#if defined(_WIN32) || defined(_WIN64)
-            baudRate = 600;
-#else
-            baudRate = B600;
-#endif
-            break;
-        case '2':
-#if defined(_WIN32) || defined(_WIN64)
-            baudRate = 1200;
-#else
-            baudRate = B1200;
-#endif
-            break;
-        case '3':
-#if defined(_WIN32) || defined(_WIN64)
-            baudRate = 2400;
-#else
-            baudRate = B2400;
-#endif
-            break;
-        case '4':
-#if defined(_WIN32) || defined(_WIN64)
-            baudRate = 4800;
-#else
-            baudRate = B4800;
-#endif
-            break;
-        case '5':
-#if defined(_WIN32) || defined(_WIN64)
-            baudRate = 9600;
-#else
-            baudRate = B9600;
-#endif
-            break;
-        case '6':
-#if defined(_WIN32) || defined(_WIN64)
-            baudRate = 19200;
-#else
-            baudRate = B19200;
-#endif
-            break;
-        default:
             return DLMS_ERROR_CODE_INVALID_PARAMETER;
         }
+        //Don't go faster than the caller allows.
+        while (ch > '0' && IEC_BAUD_RATES[ch - '0'] > (unsigned long)maxBaudrate)
+        {
+            --ch;
+        }
+        baudRate = IEC_BAUD_RATES[ch - '0'];
+        m_Baudrate = baudRate;
+        m_Speed = baudRate;
         //Send ACK
         buff[0] = 0x06;
         //Send Protocol control character
@@ -833,8 +954,8 @@ int CGXCommunication::Open(const char* settings, bool iec, int maxBaudrate)
         // 8n1, see termios.h for more information
         options.c_cflag = CS8 | CREAD | CLOCAL;
         //Set Baud Rates
-        cfsetospeed(&options, baudRate);
-        cfsetispeed(&options, baudRate);
+        cfsetospeed(&options, GXGetSpeed(baudRate));
+        cfsetispeed(&options, GXGetSpeed(baudRate));
         if (tcsetattr(m_hComPort, TCSAFLUSH, &options) != 0)
         {
             fprintf(stderr, "Failed to Open port. tcsetattr failed %d.\r\n", errno);
@@ -866,14 +987,16 @@ int CGXCommunication::UpdateFrameCounter()
         m_Parser->SetClientAddress(16);
         m_Parser->SetAuthentication(DLMS_AUTHENTICATION_NONE);
         m_Parser->GetCiphering()->SetSecurity(DLMS_SECURITY_NONE);
-        //Get meter's send and receive buffers size.
-        if ((ret = m_Parser->SNRMRequest(data)) != 0 ||
+        //Get meter's send and receive buffers size. Only HDLC has a link layer to set up.
+        if (m_Parser->GetInterfaceType() == DLMS_INTERFACE_TYPE_HDLC &&
+            ((ret = m_Parser->SNRMRequest(data)) != 0 ||
             (ret = ReadDataBlock(data, reply)) != 0 ||
-            (ret = m_Parser->ParseUAResponse(reply.GetData())) != 0)
+            (ret = m_Parser->ParseUAResponse(reply.GetData())) != 0))
         {
             fprintf(stderr, "SNRMRequest failed %d.\r\n", ret);
             return ret;
         }
+        m_LinkUp = true;
         reply.Clear();
         if ((ret = m_Parser->AARQRequest(data)) != 0 ||
             (ret = ReadDataBlock(data, reply)) != 0 ||
@@ -895,6 +1018,7 @@ int CGXCommunication::UpdateFrameCounter()
         if ((ret = Read(&d, 2, str)) == 0)
         {
             m_Parser->GetCiphering()->SetInvocationCounter(1 + d.GetValue().ToInteger());
+            m_CounterKnown = true;
         }
         fprintf(stderr, "Invocation counter: %d\r\n", m_Parser->GetCiphering()->GetInvocationCounter());
         reply.Clear();
@@ -908,24 +1032,250 @@ int CGXCommunication::UpdateFrameCounter()
 }
 
 
+std::string CGXCommunication::GetCounterKey()
+{
+    char key[64];
+    snprintf(key, sizeof(key), "counter.%lu.%d", (unsigned long)m_Parser->GetClientAddress(),
+        (int)m_Parser->GetCiphering()->GetSecuritySuite());
+    return key;
+}
+
+//Take the invocation counter from the state file.
+bool CGXCommunication::LoadFrameCounter()
+{
+    if (m_InvocationCounter == NULL ||
+        m_Parser->GetCiphering() == NULL || m_Parser->GetCiphering()->GetSecurity() == DLMS_SECURITY_NONE ||
+        !LoadState())
+    {
+        return false;
+    }
+    std::map<std::string, std::string>::iterator it = m_State.find(GetCounterKey());
+    if (it == m_State.end() || it->second.empty())
+    {
+        return false;
+    }
+    m_Parser->SetProposedConformance((DLMS_CONFORMANCE)(m_Parser->GetProposedConformance() | DLMS_CONFORMANCE_GENERAL_PROTECTION));
+    m_Parser->GetCiphering()->SetInvocationCounter(strtoul(it->second.c_str(), NULL, 10));
+    m_CounterKnown = true;
+    return true;
+}
+
+//Keep the invocation counter and the round trip times in the state file for the next session.
+void CGXCommunication::SaveState()
+{
+    std::map<std::string, std::string> values;
+    if (m_StateFile.empty())
+    {
+        return;
+    }
+    if (m_CounterKnown)
+    {
+        char value[16];
+        snprintf(value, sizeof(value), "%lu", (unsigned long)m_Parser->GetCiphering()->GetInvocationCounter());
+        values[GetCounterKey()] = value;
+    }
+    if (m_FirstRtt.IsKnown())
+    {
+        values["rtt.first"] = m_FirstRtt.ToString();
+    }
+    if (m_BlockRtt.IsKnown())
+    {
+        values["rtt.block"] = m_BlockRtt.ToString();
+    }
+    if (m_SelectRtt.IsKnown())
+    {
+        values["rtt.select"] = m_SelectRtt.ToString();
+    }
+    int ret;
+    if (!values.empty() && (ret = CGXStateFile::Update(m_StateFile, values)) != 0)
+    {
+        fprintf(stderr, "Failed to save the state to %s (%d).\r\n", m_StateFile.c_str(), ret);
+    }
+    //The loaded state is kept in step, a connection opened again in this session continues from it.
+    if (!m_State.empty())
+    {
+        for (std::map<std::string, std::string>::iterator it = values.begin(); it != values.end(); ++it)
+        {
+            m_State[it->first] = it->second;
+        }
+    }
+}
+
+//Take the round trip times from the state file.
+void CGXCommunication::LoadRtt()
+{
+    if (LoadState())
+    {
+        m_FirstRtt.FromString(m_State["rtt.first"]);
+        m_BlockRtt.FromString(m_State["rtt.block"]);
+        m_SelectRtt.FromString(m_State["rtt.select"]);
+    }
+}
+
+//Load the state file once per connection.
+bool CGXCommunication::LoadState()
+{
+    if (m_StateFile.empty())
+    {
+        return false;
+    }
+    if (m_State.empty() && CGXStateFile::Load(m_StateFile, m_State) != 0)
+    {
+        m_State.clear();
+    }
+    return true;
+}
+
+std::string CGXCommunication::GetState(const char* key) const
+{
+    std::map<std::string, std::string>::const_iterator it = m_State.find(key);
+    return it == m_State.end() ? std::string() : it->second;
+}
+
+//Use the HDLC settings which the meter accepted last time.
+//Smaller values than the configured ones are proposed, so a meter which
+//can't take the configured values is not asked for them again.
+void CGXCommunication::LoadCapability()
+{
+    if (m_Parser->GetInterfaceType() != DLMS_INTERFACE_TYPE_HDLC || !LoadState())
+    {
+        return;
+    }
+    CGXHdlcSettings& hdlc = m_Parser->GetHdlcSettings();
+    unsigned long value;
+    if ((value = strtoul(GetState("cap.info.tx").c_str(), NULL, 10)) != 0 && value < hdlc.GetMaxInfoTX())
+    {
+        hdlc.SetMaxInfoTX((unsigned short)value);
+    }
+    if ((value = strtoul(GetState("cap.info.rx").c_str(), NULL, 10)) != 0 && value < hdlc.GetMaxInfoRX())
+    {
+        hdlc.SetMaxInfoRX((unsigned short)value);
+    }
+    if ((value = strtoul(GetState("cap.window.tx").c_str(), NULL, 10)) != 0 && value < hdlc.GetWindowSizeTX())
+    {
+        hdlc.SetWindowSizeTX((unsigned char)value);
+    }
+    if ((value = strtoul(GetState("cap.window.rx").c_str(), NULL, 10)) != 0 && value < hdlc.GetWindowSizeRX())
+    {
+        hdlc.SetWindowSizeRX((unsigned char)value);
+    }
+}
+
+//Keep what the meter has granted for the next session.
+//The state file is written only when something has changed.
+void CGXCommunication::SaveCapability()
+{
+    if (!LoadState())
+    {
+        return;
+    }
+    char tmp[24];
+    std::map<std::string, std::string> values;
+    if (m_Baudrate != 0)
+    {
+        snprintf(tmp, sizeof(tmp), "%lu", m_Baudrate);
+        values["cap.baud"] = tmp;
+        values["cap.ident"] = m_Ident;
+    }
+    if (m_Direct)
+    {
+        values["cap.direct"] = "1";
+    }
+    snprintf(tmp, sizeof(tmp), "%lu", (unsigned long)m_Parser->GetNegotiatedConformance());
+    values["cap.conformance"] = tmp;
+    snprintf(tmp, sizeof(tmp), "%u", (unsigned int)m_Parser->GetMaxPduSize());
+    values["cap.pdu"] = tmp;
+    if (m_Parser->GetInterfaceType() == DLMS_INTERFACE_TYPE_HDLC)
+    {
+        CGXHdlcSettings& hdlc = m_Parser->GetHdlcSettings();
+        snprintf(tmp, sizeof(tmp), "%u", (unsigned int)hdlc.GetMaxInfoTX());
+        values["cap.info.tx"] = tmp;
+        snprintf(tmp, sizeof(tmp), "%u", (unsigned int)hdlc.GetMaxInfoRX());
+        values["cap.info.rx"] = tmp;
+        snprintf(tmp, sizeof(tmp), "%u", (unsigned int)hdlc.GetWindowSizeTX());
+        values["cap.window.tx"] = tmp;
+        snprintf(tmp, sizeof(tmp), "%u", (unsigned int)hdlc.GetWindowSizeRX());
+        values["cap.window.rx"] = tmp;
+    }
+    bool changed = false;
+    for (std::map<std::string, std::string>::iterator it = values.begin(); it != values.end(); ++it)
+    {
+        std::map<std::string, std::string>::iterator old = m_State.find(it->first);
+        if (old == m_State.end() || old->second != it->second)
+        {
+            if (old != m_State.end() && it->first != "cap.direct")
+            {
+                fprintf(stderr, "Meter has changed %s from %s to %s.\r\n", it->first.c_str(), old->second.c_str(), it->second.c_str());
+            }
+            m_State[it->first] = it->second;
+            changed = true;
+        }
+    }
+    int ret;
+    if (changed && (ret = CGXStateFile::Update(m_StateFile, values)) != 0)
+    {
+        fprintf(stderr, "Failed to save the capabilities to %s (%d).\r\n", m_StateFile.c_str(), ret);
+    }
+}
+
 //Initialize connection to the meter.
+//A cached invocation counter saves the association of the public client,
+//the counter is read from the meter only if the cached one is rejected.
+//A meter which was opened at its known speed and doesn't answer there is
+//opened again with mode E.
 int CGXCommunication::InitializeConnection()
 {
     int ret = 0;
-    if ((ret = UpdateFrameCounter()) != 0)
+    LoadCapability();
+    bool cached = LoadFrameCounter();
+    m_LinkUp = m_Parser->GetInterfaceType() != DLMS_INTERFACE_TYPE_HDLC;
+    if ((cached || (ret = UpdateFrameCounter()) == 0) &&
+        (ret = Associate()) != 0 && cached && m_LinkUp)
     {
-        return ret;
+        fprintf(stderr, "Cached invocation counter is rejected, it is read from the meter.\r\n");
+        Disconnect();
+        m_CounterKnown = false;
+        if ((ret = UpdateFrameCounter()) == 0)
+        {
+            ret = Associate();
+        }
     }
+    if (ret != 0 && m_Direct && !m_LinkUp)
+    {
+        fprintf(stderr, "Meter doesn't answer at %s baud, mode E is used.\r\n", GetState("cap.baud").c_str());
+        CGXStateFile::Update(m_StateFile, "cap.direct", "0");
+        m_State["cap.direct"] = "0";
+        //Open runs mode E now.
+        std::string settings = m_Settings;
+        if ((ret = Open(settings.c_str(), true, m_MaxBaudrate)) != 0)
+        {
+            return ret;
+        }
+        return InitializeConnection();
+    }
+    if (ret == 0)
+    {
+        SaveCapability();
+    }
+    return ret;
+}
+
+//Set up the link layer and the association.
+int CGXCommunication::Associate()
+{
+    int ret = 0;
     std::vector<CGXByteBuffer> data;
     CGXReplyData reply;
-    //Get meter's send and receive buffers size.
-    if ((ret = m_Parser->SNRMRequest(data)) != 0 ||
+    //Get meter's send and receive buffers size. Only HDLC has a link layer to set up.
+    if (m_Parser->GetInterfaceType() == DLMS_INTERFACE_TYPE_HDLC &&
+        ((ret = m_Parser->SNRMRequest(data)) != 0 ||
         (ret = ReadDataBlock(data, reply)) != 0 ||
-        (ret = m_Parser->ParseUAResponse(reply.GetData())) != 0)
+        (ret = m_Parser->ParseUAResponse(reply.GetData())) != 0))
     {
         fprintf(stderr, "SNRMRequest failed %d.\r\n", ret);
         return ret;
     }
+    m_LinkUp = true;
     reply.Clear();
     if ((ret = m_Parser->AARQRequest(data)) != 0 ||
         (ret = ReadDataBlock(data, reply)) != 0 ||
@@ -954,14 +1304,48 @@ int CGXCommunication::InitializeConnection()
     return DLMS_ERROR_CODE_OK;
 }
 
-// Read DLMS Data frame from the device.
-int CGXCommunication::ReadDLMSPacket(CGXByteBuffer& data, CGXReplyData& reply)
+//Open the link again and set up the association after the link was lost.
+//The state is saved first, so the association continues the invocation counter
+//and the round trip times of this session.
+int CGXCommunication::Reconnect()
+{
+    int ret;
+    SaveState();
+    CloseMedia();
+    m_Final = true;
+    m_Block = false;
+    m_Select = false;
+    if (!m_Host.empty())
+    {
+        std::string host = m_Host;
+        ret = Connect(host.c_str(), m_Port);
+    }
+    else if (!m_Settings.empty())
+    {
+        std::string settings = m_Settings;
+        ret = Open(settings.c_str(), m_Iec, m_MaxBaudrate);
+    }
+    else
+    {
+        return DLMS_ERROR_CODE_INVALID_PARAMETER;
+    }
+    if (ret != 0)
+    {
+        return ret;
+    }
+    return InitializeConnection();
+}
+
+//Send data and read the reply once.
+int CGXCommunication::Exchange(CGXByteBuffer& data, CGXReplyData& reply)
 {
     int ret;
     CGXByteBuffer bb;
     // std::string tmp;
     CGXReplyData notify;
-    if (data.GetSize() == 0)
+    //Blocks of a general block transfer window and frames of an HDLC window
+    //are received without a request.
+    if (data.GetSize() == 0 && !reply.IsStreaming() && m_Final)
     {
         return DLMS_ERROR_CODE_OK;
     }
@@ -970,7 +1354,16 @@ int CGXCommunication::ReadDLMSPacket(CGXByteBuffer& data, CGXReplyData& reply)
     // tmp += "\t" + data.ToHexString();
     // GXHelpers::Write("traffic.txt", tmp + "\r\n");
     int len = data.GetSize();
-    if (m_hComPort != INVALID_HANDLE_VALUE)
+    //Wait time comes from the round trip times of the meter.
+    CGXRttEstimator& rtt = m_Block ? m_BlockRtt : (m_Select ? m_SelectRtt : m_FirstRtt);
+    long timeout = rtt.GetTimeout(MIN_WAIT_TIME, m_WaitTime);
+    long long start = Monotonic();
+    bool sent = len != 0;
+    if (!sent)
+    {
+        //Streaming, nothing to send.
+    }
+    else if (m_hComPort != INVALID_HANDLE_VALUE)
     {
 #if defined(_WIN32) || defined(_WIN64)//If Windows
         DWORD sendSize = 0;
@@ -1013,6 +1406,8 @@ int CGXCommunication::ReadDLMSPacket(CGXByteBuffer& data, CGXReplyData& reply)
         //Discards old data in the rx buffer.
         tcflush(m_hComPort, TCIFLUSH);
 #endif
+        m_Assembler.Reset();
+        m_Final = true;
     }
     else if ((ret = send(m_socket, (const char*)data.GetData(), len, 0)) == -1)
     {
@@ -1026,6 +1421,15 @@ int CGXCommunication::ReadDLMSPacket(CGXByteBuffer& data, CGXReplyData& reply)
     }
     // Loop until whole DLMS packet is received.
     // tmp = "";
+#if !defined(_WIN32) && !defined(_WIN64)//If Linux
+    long long deadline = Monotonic() + timeout;
+#else
+    if (m_socket != -1)
+    {
+        DWORD tmp = (DWORD)timeout;
+        setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, (char*)&tmp, sizeof(tmp));
+    }
+#endif
     do
     {
         if (notify.GetData().GetSize() != 0)
@@ -1052,8 +1456,9 @@ int CGXCommunication::ReadDLMSPacket(CGXByteBuffer& data, CGXReplyData& reply)
         if (m_hComPort != INVALID_HANDLE_VALUE)
         {
             unsigned short pos = (unsigned short)bb.GetSize();
-            if (Read(0x7E, bb) != 0)
+            if (ReadFrame(bb, timeout) != 0)
             {
+                rtt.Timeout();
                 // tmp += bb.ToHexString(pos, bb.GetSize() - pos, true);
                 // fprintf(stderr, "Read failed.\r\n%s", tmp.c_str());
                 return DLMS_ERROR_CODE_SEND_FAILED;
@@ -1072,15 +1477,33 @@ int CGXCommunication::ReadDLMSPacket(CGXByteBuffer& data, CGXReplyData& reply)
         else
         {
             len = RECEIVE_BUFFER_SIZE;
+#if !defined(_WIN32) && !defined(_WIN64)//If Linux
+            if (WaitForData(m_socket, deadline) != DLMS_ERROR_CODE_OK)
+            {
+                rtt.Timeout();
+                fprintf(stderr, "recv failed. Timeout occurred.\n");
+                return DLMS_ERROR_CODE_RECEIVE_FAILED;
+            }
+#endif
             if ((ret = recv(m_socket, (char*)m_Receivebuff, len, 0)) == -1)
             {
 #if defined(_WIN32) || defined(_WIN64)//If Windows
+                if (WSAGetLastError() == WSAETIMEDOUT)
+                {
+                    rtt.Timeout();
+                }
                 fprintf(stderr, "recv failed %d\n", WSAGetLastError());
 #else
                 fprintf(stderr, "recv failed %d\n", errno);
 #endif
                 return DLMS_ERROR_CODE_RECEIVE_FAILED;
             }
+            //If connection is closed.
+            if (ret == 0)
+            {
+                fprintf(stderr, "recv failed. Connection closed.\n");
+                return DLMS_ERROR_CODE_RECEIVE_FAILED;
+            }
             bb.Set(m_Receivebuff, ret);
             // if (tmp.size() == 0)
             // {
@@ -1096,45 +1519,95 @@ int CGXCommunication::ReadDLMSPacket(CGXByteBuffer& data, CGXReplyData& reply)
     } while ((ret = m_Parser->GetData(bb, reply, notify)) == DLMS_ERROR_CODE_FALSE);
     // tmp += "\r\n";
     // GXHelpers::Write("traffic.txt", tmp);
-    if (ret == DLMS_ERROR_CODE_REJECTED)
+    //Only replies to a request which was sent once are measured.
+    if (sent && ret == DLMS_ERROR_CODE_OK)
     {
-#if defined(_WIN32) || defined(_WIN64)//Windows
-        Sleep(1000);
-#else
-        usleep(1000000);
-#endif
-        ret = ReadDLMSPacket(data, reply);
+        rtt.Sample((long)(Monotonic() - start));
     }
     return ret;
 }
 
-int CGXCommunication::ReadDataBlock(CGXByteBuffer& data, CGXReplyData& reply)
+// Read DLMS Data frame from the device.
+// A rejected request is sent again as the retry policy allows, if the thread may wait.
+int CGXCommunication::ReadDLMSPacket(CGXByteBuffer& data, CGXReplyData& reply)
 {
-    //If ther is no data to send.
-    if (data.GetSize() == 0)
+    int ret;
+    long delay;
+    for (int attempt = 1; ; ++attempt)
     {
-        return DLMS_ERROR_CODE_OK;
+        if ((ret = Exchange(data, reply)) != DLMS_ERROR_CODE_REJECTED || !m_RetryInThread ||
+            (delay = m_Retry.GetDelay(CGXRetryPolicy::RETRY_REJECTED, attempt)) < 0)
+        {
+            return ret;
+        }
+        fprintf(stderr, "Request rejected, sent again in %ld ms.\r\n", delay);
+#if defined(_WIN32) || defined(_WIN64)//Windows
+        Sleep(delay);
+#else
+        usleep(delay * 1000);
+#endif
     }
-    int ret;
+}
+
+//Read the rest of the blocks of a reply.
+//Inside a general block transfer window, or an HDLC window, the meter sends
+//without requests, the data is only acknowledged when the window is complete.
+//A lost block is asked again from the last one received, the blocks before it are kept.
+int CGXCommunication::ReadMoreData(CGXReplyData& reply)
+{
+    int ret = DLMS_ERROR_CODE_OK;
+    int resend = 0;
     CGXByteBuffer bb;
-    //Send data.
-    if ((ret = ReadDLMSPacket(data, reply)) != DLMS_ERROR_CODE_OK)
+    m_Block = true;
+    if ((ret = FeedRows(reply)) != 0)
     {
+        m_Block = false;
         return ret;
     }
     while (reply.IsMoreData())
     {
         bb.Clear();
-        if ((ret = m_Parser->ReceiverReady(reply.GetMoreData(), bb)) != 0)
+        if (!reply.IsStreaming() && m_Final &&
+            (ret = m_Parser->ReceiverReady(reply.GetMoreData(), bb)) != 0)
         {
-            return ret;
+            break;
         }
         if ((ret = ReadDLMSPacket(bb, reply)) != DLMS_ERROR_CODE_OK)
         {
-            return ret;
+            if (!reply.IsStreaming() && ++resend <= MAX_BLOCK_RESEND &&
+                CGXRetryPolicy::Classify(ret) == CGXRetryPolicy::RETRY_TIMEOUT)
+            {
+                fprintf(stderr, "Block is lost, it is asked again.\r\n");
+                //Receiver ready acknowledges the frames which were received.
+                m_Final = true;
+                continue;
+            }
+            break;
+        }
+        resend = 0;
+        if ((ret = FeedRows(reply)) != 0)
+        {
+            break;
         }
     }
-    return DLMS_ERROR_CODE_OK;
+    m_Block = false;
+    return ret;
+}
+
+int CGXCommunication::ReadDataBlock(CGXByteBuffer& data, CGXReplyData& reply)
+{
+    //If ther is no data to send.
+    if (data.GetSize() == 0)
+    {
+        return DLMS_ERROR_CODE_OK;
+    }
+    int ret;
+    //Send data.
+    if ((ret = ReadDLMSPacket(data, reply)) != DLMS_ERROR_CODE_OK)
+    {
+        return ret;
+    }
+    return ReadMoreData(reply);
 }
 
 
@@ -1146,27 +1619,15 @@ int CGXCommunication::ReadDataBlock(std::vector<CGXByteBuffer>& data, CGXReplyDa
         return DLMS_ERROR_CODE_OK;
     }
     int ret;
-    CGXByteBuffer bb;
     //Send data.
     for (std::vector<CGXByteBuffer>::iterator it = data.begin(); it != data.end(); ++it)
     {
         //Send data.
-        if ((ret = ReadDLMSPacket(*it, reply)) != DLMS_ERROR_CODE_OK)
+        if ((ret = ReadDLMSPacket(*it, reply)) != DLMS_ERROR_CODE_OK ||
+            (ret = ReadMoreData(reply)) != DLMS_ERROR_CODE_OK)
         {
             return ret;
         }
-        while (reply.IsMoreData())
-        {
-            bb.Clear();
-            if ((ret = m_Parser->ReceiverReady(reply.GetMoreData(), bb)) != 0)
-            {
-                return ret;
-            }
-            if ((ret = ReadDLMSPacket(bb, reply)) != DLMS_ERROR_CODE_OK)
-            {
-                return ret;
-            }
-        }
     }
     return DLMS_ERROR_CODE_OK;
 }
@@ -1198,8 +1659,14 @@ int CGXCommunication::Read(CGXDLMSObject* pObject, int attributeIndex, CGXByteBu
     std::vector<CGXByteBuffer> data;
     CGXReplyData reply;
     //Read data from the meter.
-    if ((ret = m_Parser->Read(pObject, attributeIndex, param, data)) != 0 ||
-        (ret = ReadDataBlock(data, reply)) != 0 ||
+    if ((ret = m_Parser->Read(pObject, attributeIndex, param, data)) != 0)
+    {
+        return ret;
+    }
+    m_Select = param != NULL && param->GetSize() != 0;
+    ret = ReadDataBlock(data, reply);
+    m_Select = false;
+    if (ret != 0 ||
         (ret = m_Parser->UpdateValue(*pObject, attributeIndex, reply.GetValue())) != 0)
     {
         return ret;
@@ -1209,6 +1676,120 @@ int CGXCommunication::Read(CGXDLMSObject* pObject, int attributeIndex, CGXByteBu
     return DLMS_ERROR_CODE_OK;
 }
 
+//Hand the rows of the data received so far to the row reader of ReadRows.
+int CGXCommunication::FeedRows(CGXReplyData& reply)
+{
+    //The data of an HDLC segment is decoded only when its last frame has arrived.
+    if (m_Rows == NULL || (reply.GetMoreData() & DLMS_DATA_REQUEST_TYPES_FRAME) != 0)
+    {
+        return DLMS_ERROR_CODE_OK;
+    }
+    int ret;
+    unsigned long start, size;
+    CGXByteBuffer& bb = reply.GetData();
+    if ((ret = m_Rows->Feed(bb.GetData(), bb.GetSize())) != 0)
+    {
+        return ret;
+    }
+    //The rows handed out are dropped, the reply keeps only the array header and
+    //the row which is not complete, so it doesn't grow with the size of the read.
+    if ((size = m_Rows->Release(start)) != 0)
+    {
+        unsigned long rest = bb.GetSize() - start - size;
+        if (rest != 0)
+        {
+            bb.Move(start + size, start, rest);
+        }
+        bb.SetSize(start + rest);
+        if (bb.GetPosition() > bb.GetSize())
+        {
+            bb.SetPosition(bb.GetSize());
+        }
+    }
+    return DLMS_ERROR_CODE_OK;
+}
+
+//Read the rows of an array, like the buffer of a profile, as its blocks arrive.
+//The value is not built into an object, each row is handed to the sink in its raw encoding.
+int CGXCommunication::ReadRows(CGXDLMSObject* pObject, int attributeIndex, CGXByteBuffer *param, CGXRowSink& sink)
+{
+    int ret;
+    std::vector<CGXByteBuffer> data;
+    CGXReplyData reply;
+    CGXRowReader reader(sink);
+    if ((ret = m_Parser->Read(pObject, attributeIndex, param, data)) != 0)
+    {
+        return ret;
+    }
+    m_Rows = &reader;
+    m_Select = param != NULL && param->GetSize() != 0;
+    ret = ReadDataBlock(data, reply);
+    m_Select = false;
+    m_Rows = NULL;
+    if (ret == DLMS_ERROR_CODE_OK && !reader.IsComplete())
+    {
+        ret = DLMS_ERROR_CODE_INVALID_RESPONSE;
+    }
+    return ret;
+}
+
+//Read objects with GET-with-list requests.
+int CGXCommunication::ReadList(std::vector<std::pair<CGXDLMSObject*, unsigned char> >& list, std::vector<std::string>& values, std::vector<int>& errors)
+{
+    values.clear();
+    errors.clear();
+    if (list.size() == 0)
+    {
+        return DLMS_ERROR_CODE_OK;
+    }
+    if ((m_Parser->GetNegotiatedConformance() & DLMS_CONFORMANCE_MULTIPLE_REFERENCES) == 0)
+    {
+        return DLMS_ERROR_CODE_INVALID_PARAMETER;
+    }
+    //Descriptor of an attribute takes 10 bytes in the request, 12 bytes are left for the header.
+    //This is the same limit the parser uses, so each request is sent in one message.
+    size_t count = (m_Parser->GetMaxPduSize() - 12) / 10;
+    if (count > MAX_LIST_COUNT)
+    {
+        count = MAX_LIST_COUNT;
+    }
+    if (count == 0)
+    {
+        return DLMS_ERROR_CODE_INVALID_PARAMETER;
+    }
+    int ret;
+    std::vector<std::string> v;
+    std::vector<int> e;
+    for (size_t pos = 0; pos < list.size(); pos += count)
+    {
+        std::vector<std::pair<CGXDLMSObject*, unsigned char> > part(list.begin() + pos,
+            list.begin() + (pos + count < list.size() ? pos + count : list.size()));
+        std::vector<CGXByteBuffer> data;
+        CGXReplyData reply;
+        if ((ret = m_Parser->ReadList(part, data)) != 0)
+        {
+            return ret;
+        }
+        if (data.size() != 1)
+        {
+            return DLMS_ERROR_CODE_INVALID_PARAMETER;
+        }
+        if ((ret = ReadDataBlock(data, reply)) != 0)
+        {
+            return ret;
+        }
+        //Results are split from the raw response, so the values are the same as the ones of single reads.
+        CGXByteBuffer& bb = reply.GetData();
+        if (!CGXAxdr::SplitList(bb.GetData(), bb.GetSize(), (unsigned long)part.size(), v, e))
+        {
+            return DLMS_ERROR_CODE_INVALID_PARAMETER;
+        }
+        values.insert(values.end(), v.begin(), v.end());
+        errors.insert(errors.end(), e.begin(), e.end());
+    }
+    return DLMS_ERROR_CODE_OK;
+}
+
 //Write selected object.
 int CGXCommunication::Write(CGXDLMSObject* pObject, int attributeIndex, CGXByteBuffer& value)
 {
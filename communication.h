@@ -63,9 +63,15 @@
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <poll.h>
 #endif
 
+#include <map>
 #include "dlms/include/GXDLMSSecureClient.h"
+#include "hdlc.h"
+#include "rtt.h"
+#include "retry.h"
+#include "axdr.h"
 
 class CGXCommunication
 {
@@ -74,6 +80,8 @@ class CGXCommunication
     int m_socket;
     static const unsigned int RECEIVE_BUFFER_SIZE = 2048;
     unsigned char   m_Receivebuff[RECEIVE_BUFFER_SIZE];
+    //Attributes in one GET-with-list request, all meters can handle 10.
+    static const unsigned int MAX_LIST_COUNT = 10;
     char* m_InvocationCounter;
 #if defined(_WIN32) || defined(_WIN64)//Windows includes
     HANDLE			m_hComPort;
@@ -83,9 +91,91 @@ class CGXCommunication
     int             m_hComPort;
 #endif
     int m_WaitTime;
+    CGXHdlcAssembler m_Assembler;
+    //Final bit of the last HDLC frame. Until it is set the meter sends
+    //the next frame of its window without waiting for a receiver ready.
+    bool m_Final;
+#if !defined(_WIN32) && !defined(_WIN64)//If Linux
+    //Wait until data is available or the deadline has elapsed.
+    int WaitForData(int fd, long long deadline);
+#endif
+    //Read bytes which are available, wait for the first one until the deadline.
+    int ReadAvailable(long long deadline, int& count);
     int Read(unsigned char eop, CGXByteBuffer& reply);
+    //Read next valid HDLC frame, wait timeout milliseconds for each part of it and
+    //at most the wait time and the time of the largest frame for the whole frame.
+    int ReadFrame(CGXByteBuffer& reply, long timeout);
+    //Milliseconds the largest HDLC frame takes at the line speed.
+    long GetFrameTime();
     /// Read Invocation counter (frame counter) from the meter and update it.
     int UpdateFrameCounter();
+    //State file of the meter, the last used invocation counter is kept there.
+    std::string m_StateFile;
+    //Values of the state file, loaded when the connection is opened.
+    std::map<std::string, std::string> m_State;
+    //Settings of Open, kept to fall back to mode E and to open the port again.
+    std::string m_Settings;
+    bool m_Iec;
+    int m_MaxBaudrate;
+    //Address of the TCP/IP connection, kept to connect again.
+    std::string m_Host;
+    unsigned short m_Port;
+    //Identification and baud rate of the last mode E handshake.
+    std::string m_Ident;
+    unsigned long m_Baudrate;
+    //Baud rate the serial port is set to now.
+    unsigned long m_Speed;
+    //Meter is tried at its known speed without mode E.
+    bool m_Direct;
+    //Meter has answered the SNRM, or there is no link layer.
+    bool m_LinkUp;
+    //Retry policy, a rejected request is sent again by the same thread only if m_RetryInThread is set.
+    CGXRetryPolicy m_Retry;
+    bool m_RetryInThread;
+    //Send data and read the reply once.
+    int Exchange(CGXByteBuffer& data, CGXReplyData& reply);
+    //Open serial port, with mode E if iec is set.
+    int OpenPort(const char* settings, bool iec, int maxBaudrate);
+    //Load the state file, returns false if there is none.
+    bool LoadState();
+    //Get a value of the state file, empty if it isn't there.
+    std::string GetState(const char* key) const;
+    //Use the HDLC settings which the meter accepted last time.
+    void LoadCapability();
+    //Keep what the meter has granted for the next session.
+    void SaveCapability();
+    //Invocation counter is read from the meter or the state file.
+    bool m_CounterKnown;
+    //Take the invocation counter from the state file. Returns false if it isn't there.
+    bool LoadFrameCounter();
+    //Keep the invocation counter and the round trip times in the state file for the next session.
+    void SaveState();
+    //Round trip times of the first reply of a request and of the following blocks.
+    CGXRttEstimator m_FirstRtt;
+    CGXRttEstimator m_BlockRtt;
+    //Round trip time of the first reply of a request with selective access.
+    //A meter may search its profile long before it answers, so these replies
+    //don't shorten the wait of other requests and the link setup doesn't reset their backoff.
+    CGXRttEstimator m_SelectRtt;
+    //Next reply is a following block.
+    bool m_Block;
+    //Request has selective access.
+    bool m_Select;
+    //Shortest time to wait for a reply.
+    static const long MIN_WAIT_TIME = 1000;
+    //Take the round trip times from the state file.
+    void LoadRtt();
+    //Key of the invocation counter in the state file.
+    std::string GetCounterKey();
+    //Set up the link layer and the association.
+    int Associate();
+    //Close the serial port or the socket without a disconnect request.
+    void CloseMedia();
+    //Times a lost block is asked again before the read fails.
+    static const int MAX_BLOCK_RESEND = 3;
+    //Row reader of ReadRows, fed after each block.
+    CGXRowReader* m_Rows;
+    int FeedRows(CGXReplyData& reply);
 public:
     void WriteValue(GX_TRACE_LEVEL trace, std::string line);
 public:
@@ -100,6 +190,28 @@ public:
 
     int Close();
     int Connect(const char* pAddress, unsigned short port = 4059);
+    //Use a socket which is already connected to the meter.
+    //The address is used to connect again if the link is lost.
+    int Attach(int socket, const char* pAddress, unsigned short port);
+
+    //Open the link again and set up the association after the link was lost.
+    //Returns the error of the connection or of the association.
+    int Reconnect();
+
+    //Set the state file of the meter. The invocation counter is then cached between
+    //sessions and read from the meter only when the cache is missing or rejected.
+    void SetStateFile(const std::string& path)
+    {
+        m_StateFile = path;
+    }
+
+    //Set the retry policy. If the thread may not wait, a rejected request fails
+    //at once, so the caller can schedule the session again and serve others meanwhile.
+    void SetRetryPolicy(const CGXRetryPolicy& policy, bool retryInThread)
+    {
+        m_Retry = policy;
+        m_RetryInThread = retryInThread;
+    }
 
 #if defined(_WIN32) || defined(_WIN64)//Windows includes
     int GXGetCommState(HANDLE hWnd, LPDCB DCB);
@@ -107,6 +219,8 @@ public:
 #endif
 
     //Open serial port connection.
+    //With a state file a meter which has done mode E before is first tried at its
+    //known speed, mode E is used again only if the meter doesn't answer there.
     int Open(
         //Serial port name.
         const char* pPortName,
@@ -132,7 +246,21 @@ public:
         str.append(tmp, ret);
     }
 
+    //Get milliseconds from a monotonic clock.
+    static inline long long Monotonic()
+    {
+#if defined(_WIN32) || defined(_WIN64)//Windows
+        return (long long)GetTickCount64();
+#else
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+    }
+
     int ReadDLMSPacket(CGXByteBuffer& data, CGXReplyData& reply);
+    //Read the rest of the blocks of a reply.
+    int ReadMoreData(CGXReplyData& reply);
     int ReadDataBlock(CGXByteBuffer& data, CGXReplyData& reply);
     int ReadDataBlock(std::vector<CGXByteBuffer>& data, CGXReplyData& reply);
 
@@ -142,6 +270,15 @@ public:
     int Read(CGXDLMSObject* pObject, int attributeIndex, std::string& value);
     int Read(CGXDLMSObject* pObject, int attributeIndex, CGXByteBuffer *param, std::string& value);
 
+    //Read the rows of an array, like the buffer of a profile, with optional selective access.
+    //Each row is handed to the sink as soon as the block which completes it has arrived.
+    int ReadRows(CGXDLMSObject* pObject, int attributeIndex, CGXByteBuffer *param, CGXRowSink& sink);
+
+    //Read many objects with GET-with-list requests, the raw value of each object is returned.
+    //Objects which the meter can't read get the data access result as error, other errors fail the whole list.
+    //After a failure values and errors hold the results of the requests which were answered.
+    int ReadList(std::vector<std::pair<CGXDLMSObject*, unsigned char> >& list, std::vector<std::string>& values, std::vector<int>& errors);
+
     //Write selected object.
     int Write(
         CGXDLMSObject* pObject,
@@ -0,0 +1,327 @@
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <string.h>
+#include <stdio.h>
+#include "connector.h"
+
+#if defined(_WIN32) || defined(_WIN64)//Windows includes
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define GXPoll WSAPoll
+#define GXCloseSocket closesocket
+#define GXSocketError() WSAGetLastError()
+#define GX_IN_PROGRESS(e) ((e) == WSAEWOULDBLOCK || (e) == WSAEINPROGRESS)
+#define GX_TIMEDOUT WSAETIMEDOUT
+#else //Linux includes.
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#define GXPoll poll
+#define GXCloseSocket close
+#define GXSocketError() errno
+#define GX_IN_PROGRESS(e) ((e) == EINPROGRESS)
+#define GX_TIMEDOUT ETIMEDOUT
+#endif
+
+//Maximum number of resolver threads.
+#define GX_RESOLVER_THREADS 8
+//Error of a name which can't be resolved.
+#define GX_RESOLVE_FAILED -1
+
+typedef std::chrono::steady_clock GXClock;
+
+//Names resolved by the resolver threads. The state is shared with the threads,
+//so a caller which gives up at the deadline doesn't have to wait for them.
+struct GXResolver
+{
+    std::mutex lock;
+    std::condition_variable cond;
+    std::vector<std::string> hosts;
+    std::vector<std::string> services;
+    std::vector<struct addrinfo*> results;
+    std::vector<int> errors;
+    size_t next;
+    size_t pending;
+    bool abandoned;
+
+    GXResolver() : next(0), pending(0), abandoned(false)
+    {
+    }
+};
+
+static void GXResolveWorker(std::shared_ptr<GXResolver> r)
+{
+    for (;;)
+    {
+        size_t i;
+        {
+            std::lock_guard<std::mutex> guard(r->lock);
+            if (r->abandoned || r->next == r->hosts.size())
+            {
+                return;
+            }
+            i = r->next++;
+        }
+        struct addrinfo hints, *res = NULL;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_ADDRCONFIG;
+        int ret = getaddrinfo(r->hosts[i].c_str(), r->services[i].c_str(), &hints, &res);
+        {
+            std::lock_guard<std::mutex> guard(r->lock);
+            if (r->abandoned)
+            {
+                //Caller has gone.
+                if (res != NULL)
+                {
+                    freeaddrinfo(res);
+                }
+            }
+            else
+            {
+                r->results[i] = res;
+                r->errors[i] = ret;
+            }
+            --r->pending;
+        }
+        r->cond.notify_all();
+    }
+}
+
+//Resolve the names of all targets, names which are not ready at the deadline fail.
+static void GXResolveAll(std::vector<CGXConnector::Target>& targets, std::vector<struct addrinfo*>& results, GXClock::time_point deadline)
+{
+    std::shared_ptr<GXResolver> r = std::make_shared<GXResolver>();
+    std::vector<size_t> owner;
+    struct addrinfo hints;
+    char service[6];
+    results.assign(targets.size(), NULL);
+    for (size_t i = 0; i != targets.size(); ++i)
+    {
+        snprintf(service, sizeof(service), "%u", targets[i].port);
+        //Addresses are converted at once.
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+        if (getaddrinfo(targets[i].host.c_str(), service, &hints, &results[i]) == 0)
+        {
+            continue;
+        }
+        results[i] = NULL;
+        owner.push_back(i);
+        r->hosts.push_back(targets[i].host);
+        r->services.push_back(service);
+    }
+    if (owner.empty())
+    {
+        return;
+    }
+    r->results.assign(owner.size(), NULL);
+    r->errors.assign(owner.size(), GX_RESOLVE_FAILED);
+    r->pending = owner.size();
+    size_t threads = owner.size() < GX_RESOLVER_THREADS ? owner.size() : GX_RESOLVER_THREADS;
+    for (size_t i = 0; i != threads; ++i)
+    {
+        std::thread(GXResolveWorker, r).detach();
+    }
+    std::unique_lock<std::mutex> lock(r->lock);
+    r->cond.wait_until(lock, deadline, [&r] { return r->pending == 0; });
+    r->abandoned = true;
+    for (size_t i = 0; i != owner.size(); ++i)
+    {
+        results[owner[i]] = r->results[i];
+        if (r->results[i] == NULL)
+        {
+            targets[owner[i]].error = r->errors[i] == GX_RESOLVE_FAILED ? GX_TIMEDOUT : GX_RESOLVE_FAILED;
+        }
+    }
+}
+
+static int GXSetBlocking(int s, bool blocking)
+{
+#if defined(_WIN32) || defined(_WIN64)//Windows
+    u_long mode = blocking ? 0 : 1;
+    return ioctlsocket(s, FIONBIO, &mode);
+#else
+    int flags = fcntl(s, F_GETFL, 0);
+    if (flags == -1)
+    {
+        return -1;
+    }
+    return fcntl(s, F_SETFL, blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK));
+#endif
+}
+
+//Start connecting to the next address of a target.
+//Returns the socket which is connecting, -1 if there are no more addresses.
+static int GXStartConnect(CGXConnector::Target& target, struct addrinfo*& address)
+{
+    for (; address != NULL; address = address->ai_next)
+    {
+        int s = (int)socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (s == -1)
+        {
+            target.error = GXSocketError();
+            continue;
+        }
+        if (GXSetBlocking(s, false) != 0)
+        {
+            target.error = GXSocketError();
+            GXCloseSocket(s);
+            continue;
+        }
+        if (connect(s, address->ai_addr, (int)address->ai_addrlen) == 0)
+        {
+            return s;
+        }
+        target.error = GXSocketError();
+        if (GX_IN_PROGRESS(target.error))
+        {
+            return s;
+        }
+        GXCloseSocket(s);
+    }
+    return -1;
+}
+
+void CGXConnector::ConnectAll(std::vector<Target>& targets, int timeout)
+{
+    GXClock::time_point deadline = GXClock::now() + std::chrono::milliseconds(timeout);
+    std::vector<struct addrinfo*> results, cursor;
+    std::vector<struct pollfd> fds, active;
+    std::vector<size_t> owner, activeOwner;
+#if defined(_WIN32) || defined(_WIN64)//Windows
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != NO_ERROR)
+    {
+        return;
+    }
+#endif
+    GXResolveAll(targets, results, deadline);
+    cursor = results;
+    for (size_t i = 0; i != targets.size(); ++i)
+    {
+        targets[i].socket = -1;
+        int s = GXStartConnect(targets[i], cursor[i]);
+        if (s != -1)
+        {
+            struct pollfd pfd;
+            pfd.fd = s;
+            pfd.events = POLLOUT;
+            pfd.revents = 0;
+            fds.push_back(pfd);
+            owner.push_back(i);
+        }
+    }
+    //Wait for all connections together.
+    while (!fds.empty())
+    {
+        long long left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - GXClock::now()).count();
+        int ret = left <= 0 ? 0 : GXPoll(&fds[0], fds.size(), (int)left);
+        if (ret == 0)
+        {
+            //Deadline has elapsed.
+            for (size_t i = 0; i != fds.size(); ++i)
+            {
+                targets[owner[i]].error = GX_TIMEDOUT;
+                GXCloseSocket(fds[i].fd);
+            }
+            break;
+        }
+        if (ret < 0 && GXSocketError() != EINTR)
+        {
+            for (size_t i = 0; i != fds.size(); ++i)
+            {
+                targets[owner[i]].error = GXSocketError();
+                GXCloseSocket(fds[i].fd);
+            }
+            break;
+        }
+        active.clear();
+        activeOwner.clear();
+        for (size_t i = 0; i != fds.size(); ++i)
+        {
+            Target& target = targets[owner[i]];
+            int s = fds[i].fd;
+            if (ret > 0 && fds[i].revents != 0)
+            {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                if (getsockopt(s, SOL_SOCKET, SO_ERROR, (char*)&err, &len) != 0)
+                {
+                    err = GXSocketError();
+                }
+                if (err == 0 && GXSetBlocking(s, true) == 0)
+                {
+                    target.socket = s;
+                    target.error = 0;
+#if defined(_WIN32) || defined(_WIN64)//Windows
+                    //Released when the socket is closed.
+                    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+                    continue;
+                }
+                //Try the next address.
+                target.error = err;
+                GXCloseSocket(s);
+                cursor[owner[i]] = cursor[owner[i]]->ai_next;
+                s = GXStartConnect(target, cursor[owner[i]]);
+                if (s == -1)
+                {
+                    continue;
+                }
+                fds[i].fd = s;
+            }
+            fds[i].revents = 0;
+            active.push_back(fds[i]);
+            activeOwner.push_back(owner[i]);
+        }
+        fds.swap(active);
+        owner.swap(activeOwner);
+    }
+    for (size_t i = 0; i != results.size(); ++i)
+    {
+        if (results[i] != NULL)
+        {
+            freeaddrinfo(results[i]);
+        }
+        //Every failed target gets an error.
+        if (targets[i].socket == -1 && targets[i].error == 0)
+        {
+            targets[i].error = GX_TIMEDOUT;
+        }
+    }
+#if defined(_WIN32) || defined(_WIN64)//Windows
+    WSACleanup();
+#endif
+}
+
+int CGXConnector::Connect(const char* host, unsigned short port, int timeout, int& socket)
+{
+    std::vector<Target> targets;
+    targets.push_back(Target(host, port));
+    ConnectAll(targets, timeout);
+    socket = targets[0].socket;
+    return socket == -1 ? (targets[0].error == 0 ? -1 : targets[0].error) : 0;
+}
+
+void CGXConnector::Close(int socket)
+{
+    if (socket != -1)
+    {
+        GXCloseSocket(socket);
+#if defined(_WIN32) || defined(_WIN64)//Windows
+        WSACleanup();
+#endif
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef GXCONNECTOR_H
+#define GXCONNECTOR_H
+
+#include <string>
+#include <vector>
+
+//Opens many TCP/IP connections at once.
+//Names are resolved with getaddrinfo on resolver threads, then all sockets
+//connect in non-blocking mode and are polled together. IPv4 and IPv6
+//addresses are tried in the order the resolver returns them.
+class CGXConnector
+{
+public:
+    struct Target
+    {
+        std::string host;
+        unsigned short port;
+        //Connected socket, -1 if the connection failed.
+        int socket;
+        //Error of the failed connection.
+        int error;
+
+        Target(const std::string& h, unsigned short p) : host(h), port(p), socket(-1), error(0)
+        {
+        }
+    };
+
+    //Connect all targets. Every connection has to be ready in timeout milliseconds.
+    //Connected sockets are left in blocking mode.
+    static void ConnectAll(std::vector<Target>& targets, int timeout);
+
+    //Connect one target.
+    static int Connect(const char* host, unsigned short port, int timeout, int& socket);
+
+    //Close a socket which was connected, but never used.
+    static void Close(int socket);
+};
+
+#endif //GXCONNECTOR_H
@@ -0,0 +1,340 @@
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include "decoder.h"
+#include "axdr.h"
+
+//Value of a row, before it is put into its column.
+struct GXValue
+{
+    CGXProfileDecoder::ColumnType type;
+    long long integer;
+    double real;
+};
+
+//Days since 1970-01-01 of a civil date.
+static long long GXDays(long long y, unsigned int m, unsigned int d)
+{
+    y -= m <= 2;
+    long long era = (y >= 0 ? y : y - 399) / 400;
+    unsigned int yoe = (unsigned int)(y - era * 400);
+    unsigned int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (long long)doe - 719468;
+}
+
+bool CGXProfileDecoder::GetTime(const unsigned char* dt, long long& t)
+{
+    unsigned int year = (dt[0] << 8) | dt[1];
+    if (year == 0xFFFF || dt[2] < 1 || dt[2] > 12 || dt[3] < 1 || dt[3] > 31 ||
+        dt[5] > 23 || dt[6] > 59 || dt[7] > 59)
+    {
+        return false;
+    }
+    t = GXDays(year, dt[2], dt[3]) * 86400 + dt[5] * 3600 + dt[6] * 60 + dt[7];
+    return true;
+}
+
+//Get a big endian number of count bytes.
+static unsigned long long GXGetNumber(const unsigned char* data, int count)
+{
+    unsigned long long value = 0;
+    for (int i = 0; i != count; ++i)
+    {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+//Decode one value, pos is moved past it.
+//Values which are not numbers or times are COLUMN_RAW.
+static bool GXGetValue(const unsigned char* data, unsigned long size, unsigned long& pos, bool time, GXValue& value)
+{
+    unsigned long start = pos;
+    if (!CGXAxdr::Skip(data, size, pos))
+    {
+        return false;
+    }
+    const unsigned char* p = data + start + 1;
+    value.type = CGXProfileDecoder::COLUMN_INTEGER;
+    switch (data[start])
+    {
+    case 0://Null.
+        value.type = CGXProfileDecoder::COLUMN_UNKNOWN;
+        break;
+    case 3://Boolean.
+    case 17://UInt8.
+    case 22://Enum.
+        value.integer = p[0];
+        break;
+    case 15://Int8.
+        value.integer = (signed char)p[0];
+        break;
+    case 16://Int16.
+        value.integer = (short)GXGetNumber(p, 2);
+        break;
+    case 18://UInt16.
+        value.integer = (unsigned short)GXGetNumber(p, 2);
+        break;
+    case 5://Int32.
+        value.integer = (int)GXGetNumber(p, 4);
+        break;
+    case 6://UInt32.
+        value.integer = (long long)GXGetNumber(p, 4);
+        break;
+    case 20://Int64.
+    case 21://UInt64.
+        value.integer = (long long)GXGetNumber(p, 8);
+        break;
+    case 23://Float32.
+    {
+        unsigned int bits = (unsigned int)GXGetNumber(p, 4);
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        value.type = CGXProfileDecoder::COLUMN_REAL;
+        value.real = f;
+        break;
+    }
+    case 24://Float64.
+    {
+        unsigned long long bits = GXGetNumber(p, 8);
+        memcpy(&value.real, &bits, sizeof(value.real));
+        value.type = CGXProfileDecoder::COLUMN_REAL;
+        break;
+    }
+    case 25://Date-time.
+        value.type = CGXProfileDecoder::GetTime(p, value.integer) ?
+            CGXProfileDecoder::COLUMN_TIME : CGXProfileDecoder::COLUMN_UNKNOWN;
+        break;
+    case 9://Octet string, the clock keeps its time in one.
+        if (time && p[0] == 12)
+        {
+            value.type = CGXProfileDecoder::GetTime(p + 1, value.integer) ?
+                CGXProfileDecoder::COLUMN_TIME : CGXProfileDecoder::COLUMN_UNKNOWN;
+            break;
+        }
+        value.type = CGXProfileDecoder::COLUMN_RAW;
+        break;
+    default:
+        value.type = CGXProfileDecoder::COLUMN_RAW;
+        break;
+    }
+    return true;
+}
+
+const long long CGXProfileDecoder::MISSING;
+
+CGXProfileDecoder::CGXProfileDecoder() : m_Rows(0)
+{
+}
+
+bool CGXProfileDecoder::SetCaptureObjects(const unsigned char* data, unsigned long size)
+{
+    std::vector<unsigned long> rows;
+    m_Columns.clear();
+    m_Rows = 0;
+    if (!CGXAxdr::GetRows(data, size, rows))
+    {
+        return false;
+    }
+    for (std::vector<unsigned long>::iterator it = rows.begin(); it != rows.end(); ++it)
+    {
+        //Structure of class id, logical name, attribute index and data index.
+        const unsigned char* p = data + *it;
+        if (size - *it < 18 || p[0] != 2 || p[1] != 4 || p[2] != 18 || p[5] != 9 || p[6] != 6 ||
+            p[13] != 15 || p[15] != 18)
+        {
+            m_Columns.clear();
+            return false;
+        }
+        Column column;
+        char ln[24];
+        column.classId = (unsigned short)GXGetNumber(p + 3, 2);
+        snprintf(ln, sizeof(ln), "%d.%d.%d.%d.%d.%d", p[7], p[8], p[9], p[10], p[11], p[12]);
+        column.logicalName = ln;
+        column.attribute = (signed char)p[14];
+        column.dataIndex = (unsigned short)GXGetNumber(p + 16, 2);
+        column.hasScaler = false;
+        column.scaler = 0;
+        column.type = column.classId == 8 && column.attribute == 2 ? COLUMN_TIME : COLUMN_UNKNOWN;
+        m_Columns.push_back(column);
+    }
+    return true;
+}
+
+int CGXProfileDecoder::GetScalerAttribute(unsigned short classId, signed char attribute)
+{
+    if ((classId == 3 || classId == 4) && attribute == 2)
+    {
+        return 3;
+    }
+    if (classId == 5 && (attribute == 2 || attribute == 3))
+    {
+        return 4;
+    }
+    return 0;
+}
+
+bool CGXProfileDecoder::SetScaler(size_t column, const unsigned char* data, unsigned long size)
+{
+    //Structure of the scaler (int8) and the unit (enum).
+    if (column >= m_Columns.size() || size < 6 || data[0] != 2 || data[1] != 2 || data[2] != 15)
+    {
+        return false;
+    }
+    m_Columns[column].hasScaler = true;
+    m_Columns[column].scaler = (signed char)data[3];
+    return true;
+}
+
+int CGXProfileDecoder::AddValue(Column& column, const unsigned char* data, unsigned long size)
+{
+    GXValue value;
+    unsigned long pos = 0;
+    if (!GXGetValue(data, size, pos, column.type == COLUMN_TIME, value))
+    {
+        return -1;
+    }
+    //The first value which is not null gives the type of the column.
+    if (column.type == COLUMN_UNKNOWN && value.type != COLUMN_UNKNOWN)
+    {
+        column.type = value.type;
+        if (column.type == COLUMN_INTEGER && column.hasScaler && column.scaler != 0)
+        {
+            column.type = COLUMN_REAL;
+        }
+        //Rows before it had null values.
+        column.integers.assign(column.type == COLUMN_TIME || column.type == COLUMN_INTEGER ? m_Rows : 0, MISSING);
+        column.reals.assign(column.type == COLUMN_REAL ? m_Rows : 0, NAN);
+        column.raws.assign(column.type == COLUMN_RAW ? m_Rows : 0, std::string());
+    }
+    switch (column.type)
+    {
+    case COLUMN_UNKNOWN:
+        break;
+    case COLUMN_TIME:
+        column.integers.push_back(value.type == COLUMN_TIME ? value.integer : MISSING);
+        break;
+    case COLUMN_INTEGER:
+        column.integers.push_back(value.type == COLUMN_INTEGER ? value.integer :
+            (value.type == COLUMN_REAL ? (long long)value.real : MISSING));
+        break;
+    case COLUMN_REAL:
+    {
+        double scale = column.hasScaler ? pow(10, column.scaler) : 1;
+        if (value.type == COLUMN_INTEGER)
+        {
+            column.reals.push_back(value.integer * scale);
+        }
+        else if (value.type == COLUMN_REAL)
+        {
+            column.reals.push_back(value.real * scale);
+        }
+        else
+        {
+            column.reals.push_back(NAN);
+        }
+        break;
+    }
+    case COLUMN_RAW:
+        column.raws.push_back(value.type == COLUMN_UNKNOWN ? std::string() :
+            std::string((const char*)data, pos));
+        break;
+    }
+    return (int)pos;
+}
+
+bool CGXProfileDecoder::Decode(const unsigned char* data, unsigned long size)
+{
+    std::vector<unsigned long> rows;
+    if (!CGXAxdr::GetRows(data, size, rows))
+    {
+        return false;
+    }
+    for (std::vector<unsigned long>::iterator it = rows.begin(); it != rows.end(); ++it)
+    {
+        unsigned long pos = *it, count;
+        if (data[pos++] != 2 || !CGXAxdr::GetLength(data, size, pos, count) || count != m_Columns.size())
+        {
+            return false;
+        }
+        for (std::vector<Column>::iterator c = m_Columns.begin(); c != m_Columns.end(); ++c)
+        {
+            int ret = AddValue(*c, data + pos, size - pos);
+            if (ret < 0)
+            {
+                return false;
+            }
+            pos += ret;
+        }
+        ++m_Rows;
+    }
+    return true;
+}
+
+void CGXProfileDecoder::Clear()
+{
+    for (std::vector<Column>::iterator it = m_Columns.begin(); it != m_Columns.end(); ++it)
+    {
+        it->integers.clear();
+        it->reals.clear();
+        it->raws.clear();
+    }
+    m_Rows = 0;
+}
+
+//Put a little endian number of count bytes.
+static void GXPutNumber(std::string& out, unsigned long long value, int count)
+{
+    for (int i = 0; i != count; ++i)
+    {
+        out.push_back((char)(value >> (8 * i)));
+    }
+}
+
+int CGXProfileDecoder::Write(FILE* f) const
+{
+    std::string out("GXC1");
+    GXPutNumber(out, m_Rows, 4);
+    GXPutNumber(out, m_Columns.size(), 2);
+    for (std::vector<Column>::const_iterator it = m_Columns.begin(); it != m_Columns.end(); ++it)
+    {
+        char name[48];
+        int len = snprintf(name, sizeof(name), "%u/%s/%d", it->classId, it->logicalName.c_str(), it->attribute);
+        out.push_back((char)it->type);
+        out.push_back((char)len);
+        out.append(name, len);
+    }
+    for (std::vector<Column>::const_iterator it = m_Columns.begin(); it != m_Columns.end(); ++it)
+    {
+        for (unsigned long row = 0; row != m_Rows; ++row)
+        {
+            switch (it->type)
+            {
+            case COLUMN_TIME:
+            case COLUMN_INTEGER:
+                GXPutNumber(out, (unsigned long long)it->integers[row], 8);
+                break;
+            case COLUMN_REAL:
+            {
+                unsigned long long bits;
+                memcpy(&bits, &it->reals[row], sizeof(bits));
+                GXPutNumber(out, bits, 8);
+                break;
+            }
+            case COLUMN_RAW:
+                GXPutNumber(out, it->raws[row].size(), 2);
+                out.append(it->raws[row]);
+                break;
+            default:
+                //All values of the column are null.
+                break;
+            }
+        }
+    }
+    if (fwrite(out.data(), 1, out.size(), f) != out.size() || fflush(f) != 0)
+    {
+        return errno;
+    }
+    return 0;
+}
@@ -0,0 +1,98 @@
+#ifndef GXDECODER_H
+#define GXDECODER_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+//Decodes the buffer of a profile (IEC 62056-6-2, class 7) into typed columns.
+//The columns are taken from the capture objects of the profile. Capture times
+//become seconds since 1970, integers stay integers and values with a scaler
+//become doubles with the scaler applied. Other values are kept in their raw
+//A-XDR encoding.
+class CGXProfileDecoder
+{
+public:
+    enum ColumnType
+    {
+        //Type is taken from the first value of the column.
+        COLUMN_UNKNOWN,
+        //Date-time as seconds since 1970, the deviation is not applied.
+        COLUMN_TIME,
+        COLUMN_INTEGER,
+        COLUMN_REAL,
+        COLUMN_RAW
+    };
+
+    //Integer or time which is missing in a row, like a null value.
+    static const long long MISSING = (-9223372036854775807LL - 1);
+
+    struct Column
+    {
+        //Capture object of the column.
+        unsigned short classId;
+        std::string logicalName;
+        signed char attribute;
+        unsigned short dataIndex;
+        //Scaler of the value, valid if hasScaler is set.
+        bool hasScaler;
+        signed char scaler;
+        ColumnType type;
+        //Values of the column, only the vector of its type is used.
+        //A missing real is NaN, a missing raw value is empty.
+        std::vector<long long> integers;
+        std::vector<double> reals;
+        std::vector<std::string> raws;
+    };
+
+private:
+    std::vector<Column> m_Columns;
+    unsigned long m_Rows;
+    int AddValue(Column& column, const unsigned char* data, unsigned long size);
+public:
+    CGXProfileDecoder();
+
+    //Get the seconds since 1970 of the 12 bytes of a date-time.
+    //Returns false if the date or the time is not specified.
+    static bool GetTime(const unsigned char* dt, long long& t);
+
+    //Set the columns from the capture objects, attribute 3 of the profile.
+    //Returns false if the data is not an array of capture object definitions.
+    bool SetCaptureObjects(const unsigned char* data, unsigned long size);
+
+    //Does the value of a capture object have a scaler, and which attribute of the object holds it.
+    //Registers and extended registers keep it in attribute 3, demand registers in attribute 4.
+    static int GetScalerAttribute(unsigned short classId, signed char attribute);
+
+    //Set the scaler of a column from its raw scaler_unit structure.
+    //Returns false if the data is not a scaler_unit.
+    bool SetScaler(size_t column, const unsigned char* data, unsigned long size);
+
+    //Add the rows of the buffer of the profile, attribute 2.
+    //Returns false if a row doesn't match the capture objects.
+    bool Decode(const unsigned char* data, unsigned long size);
+
+    //Remove the rows, the columns and their scalers are kept.
+    void Clear();
+
+    unsigned long GetRows() const
+    {
+        return m_Rows;
+    }
+
+    const std::vector<Column>& GetColumns() const
+    {
+        return m_Columns;
+    }
+
+    //Write the rows in the binary format. Each call writes one block:
+    //"GXC1", the row count (uint32) and the column count (uint16), then for
+    //each column its type (uint8) and its name (uint8 length and text, like
+    //"3/1.0.1.8.0.255/2"), then the values of each column one after another.
+    //Times and integers are int64, reals float64 and raw values are a uint16
+    //length and the bytes. All numbers are little endian.
+    //Returns 0 or the system error.
+    int Write(FILE* f) const;
+};
+
+#endif //GXDECODER_H
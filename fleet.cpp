@@ -0,0 +1,372 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gather.h"
+#include "connector.h"
+
+/* How many lines the connect stage may work ahead of the workers. */
+#define FLEET_CONNECT_AHEAD 256
+
+/* Meters sharing one serial port or TCP endpoint, polled one after another. */
+struct fleet_line {
+	std::string device;
+	std::vector<struct parameter *> meters;
+
+	/* TCP/IP endpoint of the line. */
+	bool tcp = false;
+	std::string host;
+	unsigned short port = 0;
+	/* Socket opened by the connect stage for the first meter. */
+	int socket = -1;
+	int error = 0;
+	/* A worker is polling a meter of the line. */
+	bool busy = false;
+};
+
+/* Meter which failed and is polled again later in the cycle. */
+struct fleet_retry {
+	size_t line;
+	size_t meter;
+	int attempt;
+	std::chrono::steady_clock::time_point when;
+};
+
+/* State shared by the workers and the connect stage during a cycle. */
+struct fleet_cycle {
+	std::vector<struct fleet_line> *lines = nullptr;
+	/* Next line to poll. */
+	size_t next = 0;
+	/* Lines before this one have passed the connect stage. */
+	size_t ready = 0;
+	/* Meters waiting for their next attempt. */
+	std::vector<struct fleet_retry> retries;
+	/* Workers polling a meter. */
+	unsigned int running = 0;
+	std::mutex lock;
+	std::condition_variable cond;
+	std::mutex output;
+	struct session_stat total;
+	/* Keys of the meters, null if the fleet file has them. */
+	const CGXKeyStore *keys = nullptr;
+};
+
+static std::atomic<bool> fleet_stop(false);
+
+static void fleet_signal(int sig) {
+	fleet_stop = true;
+}
+
+/* Open the TCP/IP connections of the lines in batches, ahead of the workers. */
+static void fleet_connector(struct fleet_cycle& c, const struct fleet_option& o) {
+	std::vector<struct fleet_line>& lines = *c.lines;
+
+	for(;;) {
+		size_t from, to;
+		{
+			std::unique_lock<std::mutex> lock(c.lock);
+			c.cond.wait(lock, [&c] { return fleet_stop || (c.ready < c.next + FLEET_CONNECT_AHEAD); });
+			if(fleet_stop || (c.ready >= c.lines->size())) {
+				c.ready = c.lines->size();
+				c.cond.notify_all();
+				return;
+			}
+			from = c.ready;
+			to = c.next + FLEET_CONNECT_AHEAD;
+			if(to > lines.size()) {
+				to = lines.size();
+			}
+		}
+
+		std::vector<CGXConnector::Target> targets;
+		std::vector<size_t> index;
+		for(size_t i = from; i < to; i++) {
+			if(lines[i].tcp) {
+				targets.push_back(CGXConnector::Target(lines[i].host, lines[i].port));
+				index.push_back(i);
+			}
+		}
+		if(!targets.empty()) {
+			CGXConnector::ConnectAll(targets, o.connect);
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(c.lock);
+			for(size_t i = 0; i < index.size(); i++) {
+				lines[index[i]].socket = targets[i].socket;
+				lines[index[i]].error = targets[i].error;
+			}
+			c.ready = to;
+		}
+		c.cond.notify_all();
+	}
+}
+
+/* Take the next meter to poll: a due retry on a free line, else the next line. */
+static bool fleet_take(struct fleet_cycle& c, struct fleet_retry& job) {
+	std::vector<struct fleet_line>& lines = *c.lines;
+	std::unique_lock<std::mutex> lock(c.lock);
+
+	while(!fleet_stop) {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		std::chrono::steady_clock::time_point wake = now + std::chrono::seconds(1);
+		for(std::vector<struct fleet_retry>::iterator it = c.retries.begin(); it != c.retries.end(); it++) {
+			if(lines[it->line].busy) {
+				continue;
+			}
+			if(it->when <= now) {
+				job = *it;
+				c.retries.erase(it);
+				lines[job.line].busy = true;
+				c.running ++;
+				return true;
+			}
+			if(it->when < wake) {
+				wake = it->when;
+			}
+		}
+		if(c.next < lines.size()) {
+			job.line = c.next ++;
+			job.meter = 0;
+			job.attempt = 0;
+			lines[job.line].busy = true;
+			c.running ++;
+			c.cond.notify_all();
+			/* Wait for the connect stage. */
+			if(lines[job.line].tcp) {
+				size_t i = job.line;
+				c.cond.wait(lock, [&c, i] { return c.ready > i; });
+			}
+			return true;
+		}
+		if(c.retries.empty() && (c.running == 0)) {
+			break;
+		}
+		/* Wait until a retry is due or another worker frees a line. */
+		c.cond.wait_until(lock, wake);
+	}
+	c.cond.notify_all();
+	return false;
+}
+
+static void fleet_worker(struct fleet_cycle& c, const struct fleet_option& o) {
+	std::vector<struct fleet_line>& lines = *c.lines;
+	struct session_stat total;
+	struct fleet_retry job;
+
+	while(fleet_take(c, job)) {
+		struct fleet_line& l = lines[job.line];
+		int socket = -1;
+		size_t last = job.meter + 1;
+
+		/* A new line polls all of its meters, a retry only the meter which failed. */
+		if(job.attempt == 0) {
+			std::lock_guard<std::mutex> guard(c.lock);
+			socket = l.socket;
+			l.socket = -1;
+			last = l.meters.size();
+		}
+		for(size_t m = job.meter; (m < last) && !fleet_stop; m++) {
+			struct parameter& p = *l.meters[m];
+			struct session_stat st;
+			int attempt = m == job.meter ? job.attempt : 0;
+			int ret;
+			std::string line = p.name + " ";
+
+			if(l.tcp && (m == 0) && (attempt == 0) && (socket == -1)) {
+				st.meters ++;
+				st.failures ++;
+				fprintf(stderr, "Failed to connect to %s (%d)\n", l.device.data(), l.error);
+				ret = -1;
+			}
+			else {
+				ret = session_run(p, line, st, socket, &o.retry, c.keys ? c.keys->Get(p.name) : nullptr);
+			}
+			/* The session owns the socket, the other meters of the line connect again. */
+			socket = -1;
+
+			CGXRetryPolicy::ErrorClass ec = CGXRetryPolicy::RETRY_NONE;
+			if(ret == -1) {
+				ec = CGXRetryPolicy::RETRY_CONNECT;
+			}
+			else if(ret != 0) {
+				ec = CGXRetryPolicy::Classify(ret);
+			}
+			long delay = ec == CGXRetryPolicy::RETRY_NONE ? -1 : o.retry.GetDelay(ec, attempt + 1);
+			if(delay >= 0) {
+				/* Poll the other meters meanwhile instead of sleeping in the worker. */
+				struct fleet_retry r;
+				r.line = job.line;
+				r.meter = m;
+				r.attempt = attempt + 1;
+				r.when = std::chrono::steady_clock::now() + std::chrono::milliseconds(delay);
+				{
+					std::lock_guard<std::mutex> guard(c.lock);
+					c.retries.push_back(r);
+				}
+				/* The marks of the profiles have moved past the rows which were read, they are written
+				 * now and the retry reads only the rest. */
+				if(st.elements != 0) {
+					line.append("RETRY\n");
+					std::lock_guard<std::mutex> guard(c.output);
+					fwrite(line.data(), 1, line.size(), stdout);
+					fflush(stdout);
+				}
+				continue;
+			}
+			if(st.failures != 0) {
+				line.append("FAILED");
+			}
+			line.append("\n");
+			total.meters += st.meters;
+			total.failures += st.failures;
+			total.elements += st.elements;
+			/* Write the whole line at once, so the results of different meters never mix. */
+			std::lock_guard<std::mutex> guard(c.output);
+			fwrite(line.data(), 1, line.size(), stdout);
+			fflush(stdout);
+		}
+		if(socket != -1) {
+			CGXConnector::Close(socket);
+		}
+		{
+			std::lock_guard<std::mutex> guard(c.lock);
+			l.busy = false;
+			c.running --;
+		}
+		c.cond.notify_all();
+	}
+
+	std::lock_guard<std::mutex> guard(c.output);
+	c.total.meters += total.meters;
+	c.total.failures += total.failures;
+	c.total.elements += total.elements;
+}
+
+bool fleet_kek(std::string& kek) {
+	const char *hex = getenv("GATHER_KEK");
+	if((hex == NULL) || ((strlen(hex) != 32) && (strlen(hex) != 48) && (strlen(hex) != 64))) {
+		return false;
+	}
+	CGXByteBuffer bb;
+	bb.SetHexString(hex);
+	if(bb.GetSize() * 2 != strlen(hex)) {
+		return false;
+	}
+	kek.assign(reinterpret_cast<const char *>(bb.GetData()), bb.GetSize());
+	return true;
+}
+
+int fleet_run(std::vector<struct parameter>& fleet, const struct fleet_option& o) {
+	std::vector<struct fleet_line> lines;
+	std::map<std::string, size_t> index;
+	CGXKeyStore keys;
+	std::string kek;
+
+	/* The keys are unwrapped once here, a session only looks up its meter. */
+	if(!o.keys.empty()) {
+		if(!fleet_kek(kek)) {
+			fprintf(stderr, "GATHER_KEK should be the hex of a key of 16, 24 or 32 bytes\n");
+			return -1;
+		}
+		int ret = keys.Load(o.keys, kek);
+		if(ret != 0) {
+			fprintf(stderr, "Failed to load the keys of %s (%d)\n", o.keys.data(), ret);
+			return -1;
+		}
+		fprintf(stderr, "Keys: %u meters\n", (unsigned int)keys.GetCount());
+	}
+
+	/* Group meters by line, a line is driven by only one worker at a time. */
+	for(std::vector<struct parameter>::iterator iter = fleet.begin(); iter != fleet.end(); iter++) {
+		std::string port = device_port(iter->device);
+		std::map<std::string, size_t>::iterator it = index.find(port);
+		if(it == index.end()) {
+			struct fleet_line l;
+			l.device = port;
+			l.tcp = device_tcp(port, l.host, l.port);
+			index[port] = lines.size();
+			lines.push_back(l);
+			it = index.find(port);
+		}
+		lines[it->second].meters.push_back(&(*iter));
+	}
+
+	unsigned int workers = o.workers;
+	if(workers > lines.size()) {
+		workers = lines.size();
+	}
+	if(workers < 1) {
+		workers = 1;
+	}
+
+	signal(SIGINT, fleet_signal);
+	signal(SIGTERM, fleet_signal);
+
+	fprintf(stderr, "Fleet: %u meters on %u lines, %u workers\n",
+		(unsigned int)fleet.size(), (unsigned int)lines.size(), workers);
+
+	for(unsigned long cycle = 1; !fleet_stop; cycle++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::vector<std::thread> threads;
+		struct fleet_cycle c;
+
+		/* Keys which changed are taken between cycles, a session never sees half a file. */
+		if(!o.keys.empty()) {
+			int ret = keys.Reload();
+			if(ret != 0) {
+				fprintf(stderr, "Failed to reload the keys of %s (%d), the keys before are kept\n", o.keys.data(), ret);
+			}
+			c.keys = &keys;
+		}
+		c.lines = &lines;
+		std::thread connector(fleet_connector, std::ref(c), std::cref(o));
+		for(unsigned int i = 0; i < workers; i++) {
+			threads.push_back(std::thread(fleet_worker, std::ref(c), std::cref(o)));
+		}
+		for(std::vector<std::thread>::iterator iter = threads.begin(); iter != threads.end(); iter++) {
+			iter->join();
+		}
+		{
+			/* Wake the connect stage if it waits for the workers. */
+			std::lock_guard<std::mutex> guard(c.lock);
+			c.next = lines.size() + FLEET_CONNECT_AHEAD;
+		}
+		c.cond.notify_all();
+		connector.join();
+		/* Connections which were never used after a stop. */
+		for(std::vector<struct fleet_line>::iterator iter = lines.begin(); iter != lines.end(); iter++) {
+			if(iter->socket != -1) {
+				CGXConnector::Close(iter->socket);
+				iter->socket = -1;
+			}
+		}
+
+		struct session_stat& total = c.total;
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if(elapsed <= 0) {
+			elapsed = 1e-6;
+		}
+		fprintf(stderr, "Cycle %lu: %lu meters (%lu failed), %lu elements in %.3f s, %.2f meters/s, %.2f elements/s\n",
+			cycle, total.meters, total.failures, total.elements, elapsed,
+			(total.meters - total.failures) / elapsed, total.elements / elapsed);
+
+		if(o.interval == 0) {
+			break;
+		}
+		/* Wait for the next cycle, the stop flag is checked every second. */
+		while(!fleet_stop && (std::chrono::steady_clock::now() - start < std::chrono::seconds(o.interval))) {
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+		}
+	}
+
+	return 0;
+}
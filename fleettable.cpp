@@ -0,0 +1,282 @@
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "gather.h"
+#include "mapfile.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#include <io.h>
+#define table_fsync(f) _commit(_fileno(f))
+#else
+#include <unistd.h>
+#define table_fsync(f) fsync(fileno(f))
+#endif
+
+/* A fleet table is "GXF2", the options of the daemon, the count of meters, the offset of each meter
+ * and then the meters. Numbers are little endian, strings are a uint16 length and the bytes. */
+#define TABLE_MAGIC "GXF2"
+
+static void table_number(std::string& out, uint64_t value, int count) {
+	for(int i = 0; i < count; i++) {
+		out.push_back((char)(value >> (8 * i)));
+	}
+}
+
+static void table_string(std::string& out, const std::string& value) {
+	table_number(out, value.size(), 2);
+	out.append(value);
+}
+
+static void table_bytes(std::string& out, CGXByteBuffer& value) {
+	table_number(out, value.GetSize(), 2);
+	out.append(reinterpret_cast<const char *>(value.GetData()), value.GetSize());
+}
+
+/* Reads the fields of a mapped table, ok is cleared when a field runs past the end. */
+struct table_reader {
+	const unsigned char *data;
+	unsigned long size;
+	unsigned long pos;
+	bool ok;
+
+	uint64_t number(int count) {
+		uint64_t value = 0;
+		if(size - pos < (unsigned long)count) {
+			ok = false;
+			return 0;
+		}
+		for(int i = count - 1; i >= 0; i--) {
+			value = (value << 8) | data[pos + i];
+		}
+		pos += count;
+		return value;
+	}
+
+	void string(std::string& value) {
+		unsigned long length = (unsigned long)number(2);
+		if(!ok || (size - pos < length)) {
+			ok = false;
+			return;
+		}
+		value.assign(reinterpret_cast<const char *>(data) + pos, length);
+		pos += length;
+	}
+
+	void bytes(CGXByteBuffer& value) {
+		unsigned long length = (unsigned long)number(2);
+		value.Clear();
+		if(!ok || (size - pos < length)) {
+			ok = false;
+			return;
+		}
+		value.Set(data + pos, length);
+		pos += length;
+	}
+};
+
+static void table_meter(std::string& out, struct parameter& p) {
+	table_string(out, p.name);
+	table_string(out, p.device);
+	table_number(out, p.interfaceType, 1);
+	table_number(out, p.mode, 1);
+	table_number(out, p.client, 1);
+	table_number(out, p.logical, 2);
+	table_number(out, p.physical, 2);
+	table_number(out, p.level, 1);
+	table_number(out, p.negotiate, 1);
+	table_number(out, p.info, 2);
+	table_number(out, p.frames, 1);
+	table_number(out, p.window, 1);
+	table_string(out, p.counter);
+	table_string(out, p.state);
+	table_number(out, p.chunk, 4);
+	table_number(out, p.rows, 4);
+	table_string(out, p.decode);
+	table_string(out, p.store);
+	table_number(out, p.backfill, 4);
+	table_bytes(out, p.password);
+	table_bytes(out, p.ekey);
+	table_bytes(out, p.akey);
+	table_bytes(out, p.title);
+	table_number(out, p.elements.size(), 2);
+	for(std::vector<struct element>::iterator e = p.elements.begin(); e != p.elements.end(); e++) {
+		table_number(out, e->classID, 2);
+		table_string(out, e->obis);
+		table_number(out, e->index, 1);
+		table_number(out, e->select, 1);
+		table_number(out, (uint64_t)e->from, 8);
+		table_number(out, (uint64_t)e->to, 8);
+		table_number(out, e->mark, 1);
+		table_number(out, e->columns.size(), 2);
+		for(size_t c = 0; c < e->columns.size(); c++) {
+			table_number(out, e->columns[c], 2);
+		}
+		/* The selectors which don't need the capture objects of the meter are compiled here. */
+		if((e->classID == 7) && (e->index == 2)) {
+			profile_compile(*e, PROFILE_BY_ENTRY);
+			if(e->columns.empty()) {
+				profile_compile(*e, PROFILE_BY_RANGE);
+			}
+		}
+		table_string(out, e->plan.entry);
+		table_string(out, e->plan.range);
+	}
+}
+
+/* Check the values of a loaded meter against the ranges of the fleet file, a damaged table may hold any value. */
+static bool table_check(const struct parameter& p) {
+	if(((p.interfaceType != DLMS_INTERFACE_TYPE_HDLC) && (p.interfaceType != DLMS_INTERFACE_TYPE_WRAPPER)) ||
+		((p.mode != 1) && (p.mode != 2) && (p.mode != 4)) || (p.client < 1) || (p.client > 127) ||
+		(p.logical < 1) || (p.logical > 16383) || (p.physical > 16383) ||
+		((p.level != DLMS_AUTHENTICATION_NONE) && (p.level != DLMS_AUTHENTICATION_LOW) && (p.level != DLMS_AUTHENTICATION_HIGH_GMAC)) ||
+		(p.info < 32) || (p.info > 2030) || (p.frames < 1) || (p.frames > 7) || (p.window > 63) ||
+		(p.chunk > 31536000) || (p.rows > 65535) || (p.backfill > 31536000)) {
+		return false;
+	}
+	for(std::vector<struct element>::const_iterator e = p.elements.begin(); e != p.elements.end(); e++) {
+		if((e->index < 1) || ((e->select != 0) && (e->select != PROFILE_BY_RANGE) && (e->select != PROFILE_BY_ENTRY))) {
+			return false;
+		}
+		for(size_t c = 0; c < e->columns.size(); c++) {
+			if((e->columns[c] < 1) || ((c != 0) && (e->columns[c] <= e->columns[c - 1]))) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static void table_load_meter(struct table_reader& r, struct parameter& p) {
+	r.string(p.name);
+	r.string(p.device);
+	p.interfaceType = (DLMS_INTERFACE_TYPE)r.number(1);
+	p.mode = (uint8_t)r.number(1);
+	p.client = (uint8_t)r.number(1);
+	p.logical = (uint16_t)r.number(2);
+	p.physical = (uint16_t)r.number(2);
+	p.level = (DLMS_AUTHENTICATION)r.number(1);
+	p.negotiate = r.number(1) != 0;
+	p.info = (uint16_t)r.number(2);
+	p.frames = (uint8_t)r.number(1);
+	p.window = (uint8_t)r.number(1);
+	r.string(p.counter);
+	r.string(p.state);
+	p.chunk = (uint32_t)r.number(4);
+	p.rows = (uint32_t)r.number(4);
+	r.string(p.decode);
+	r.string(p.store);
+	p.backfill = (uint32_t)r.number(4);
+	r.bytes(p.password);
+	r.bytes(p.ekey);
+	r.bytes(p.akey);
+	r.bytes(p.title);
+	p.elements.resize((size_t)r.number(2));
+	for(std::vector<struct element>::iterator e = p.elements.begin(); r.ok && (e != p.elements.end()); e++) {
+		e->classID = (uint16_t)r.number(2);
+		r.string(e->obis);
+		e->index = (uint8_t)r.number(1);
+		e->select = (uint8_t)r.number(1);
+		e->from = (long long)r.number(8);
+		e->to = (long long)r.number(8);
+		e->mark = r.number(1) != 0;
+		e->columns.resize((size_t)r.number(2));
+		for(size_t c = 0; r.ok && (c < e->columns.size()); c++) {
+			e->columns[c] = (uint16_t)r.number(2);
+		}
+		r.string(e->plan.entry);
+		r.string(e->plan.range);
+	}
+}
+
+int fleet_compile(std::vector<struct parameter>& fleet, const struct fleet_option& o, const char *path) {
+	std::string out(TABLE_MAGIC), meters;
+	std::vector<uint32_t> offsets;
+
+	table_number(out, o.workers, 4);
+	table_number(out, o.interval, 4);
+	table_number(out, (uint32_t)o.connect, 4);
+	for(int i = CGXRetryPolicy::RETRY_REJECTED; i < CGXRetryPolicy::RETRY_CLASS_COUNT; i++) {
+		const CGXRetryPolicy::Rule& rule = o.retry.GetRule((CGXRetryPolicy::ErrorClass)i);
+		table_number(out, (uint32_t)rule.attempts, 4);
+		table_number(out, (uint32_t)rule.base, 4);
+		table_number(out, (uint32_t)rule.max, 4);
+	}
+	table_string(out, o.keys);
+	table_number(out, fleet.size(), 4);
+	for(std::vector<struct parameter>::iterator p = fleet.begin(); p != fleet.end(); p++) {
+		offsets.push_back((uint32_t)meters.size());
+		table_meter(meters, *p);
+	}
+	/* The offsets are from the start of the file. */
+	uint32_t start = (uint32_t)(out.size() + 4 * offsets.size());
+	for(size_t i = 0; i < offsets.size(); i++) {
+		table_number(out, start + offsets[i], 4);
+	}
+	out.append(meters);
+
+	/* The table is written beside and moved over the old one, a daemon which starts never sees half a table. */
+	std::string tmp = std::string(path) + ".tmp";
+	FILE *f = fopen(tmp.data(), "wb");
+	if(f == NULL) {
+		return errno;
+	}
+	int ret = 0;
+	if((fwrite(out.data(), 1, out.size(), f) != out.size()) || (fflush(f) != 0) || (table_fsync(f) != 0)) {
+		ret = errno;
+	}
+	if((fclose(f) != 0) && (ret == 0)) {
+		ret = errno;
+	}
+#if defined(_WIN32) || defined(_WIN64)
+	if((ret == 0) && !MoveFileExA(tmp.data(), path, MOVEFILE_REPLACE_EXISTING)) {
+		ret = (int)GetLastError();
+	}
+#else
+	if((ret == 0) && (rename(tmp.data(), path) != 0)) {
+		ret = errno;
+	}
+#endif
+	if(ret != 0) {
+		remove(tmp.data());
+	}
+	return ret;
+}
+
+int fleet_load(const char *path, std::vector<struct parameter>& fleet, struct fleet_option& o) {
+	CGXMappedFile file;
+
+	if((file.Open(path) != 0) || (file.GetSize() < 4) || (memcmp(file.GetData(), TABLE_MAGIC, 4) != 0)) {
+		return 0;
+	}
+	struct table_reader r = { file.GetData(), file.GetSize(), 4, true };
+	o.workers = (unsigned int)r.number(4);
+	o.interval = (unsigned int)r.number(4);
+	o.connect = (int)r.number(4);
+	for(int i = CGXRetryPolicy::RETRY_REJECTED; i < CGXRetryPolicy::RETRY_CLASS_COUNT; i++) {
+		int attempts = (int)r.number(4);
+		long base = (long)r.number(4);
+		long max = (long)r.number(4);
+		o.retry.SetRule((CGXRetryPolicy::ErrorClass)i, attempts, base, max);
+	}
+	r.string(o.keys);
+	unsigned long count = (unsigned long)r.number(4);
+	if(!r.ok || (count > (r.size - r.pos) / 4)) {
+		return -1;
+	}
+	fleet.clear();
+	fleet.resize(count);
+	for(unsigned long i = 0; i < count; i++) {
+		struct table_reader m = { file.GetData(), file.GetSize(), (unsigned long)r.number(4), true };
+		if(m.pos > m.size) {
+			return -1;
+		}
+		table_load_meter(m, fleet[i]);
+		if(!m.ok || !table_check(fleet[i])) {
+			return -1;
+		}
+	}
+	return 1;
+}
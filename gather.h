@@ -0,0 +1,170 @@
+#ifndef GATHER_H
+#define GATHER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <stdint.h>
+#include "dlms/include/GXDLMSSecureClient.h"
+#include "dlms/include/GXBytebuffer.h"
+#include "retry.h"
+#include "keystore.h"
+
+/* Requests of an element compiled on its first read, later reads only patch their range into them.
+ * They are kept between the sessions of a meter and compiled again when a read is refused. */
+struct element_plan {
+	/* Selector by range with the restricting object and the selected values, empty is not compiled. */
+	std::string range;
+	/* Selector by entry with the first and the last column. */
+	std::string entry;
+};
+
+struct element {
+    uint16_t classID = 0;
+    std::string obis;
+    uint8_t index = 0;
+	/* Selective access of a profile, from and to are inclusive capture times or entries. */
+	uint8_t select = 0;
+	long long from = 0;
+	long long to = 0;
+	/* Profile read incrementally, the range starts after the mark in the state file. */
+	bool mark = false;
+	/* Columns of a profile to read, counted from 1 in the capture objects. Empty reads all. */
+	std::vector<uint16_t> columns;
+	struct element_plan plan;
+};
+
+/* Selective access of a profile, the values are the access selectors of DLMS. */
+#define PROFILE_BY_RANGE 1
+#define PROFILE_BY_ENTRY 2
+
+struct parameter {
+	/* Meter identity, used by the fleet daemon. */
+	std::string name;
+	std::string device;
+	DLMS_INTERFACE_TYPE interfaceType = DLMS_INTERFACE_TYPE_HDLC;
+
+	uint8_t mode = 4;
+    uint8_t client = 16;
+    uint16_t logical = 1;
+    uint16_t physical = 0;
+	DLMS_AUTHENTICATION level = DLMS_AUTHENTICATION_NONE;
+	bool negotiate = false;
+	/* Max information field length and window size of HDLC, proposed in SNRM. */
+	uint16_t info = 128;
+	uint8_t frames = 1;
+	/* Window size of general block transfer, 0 means not used. */
+	uint8_t window = 0;
+
+	/* OBIS of the invocation counter, read before a secured association. */
+	std::string counter;
+	/* Directory of the state files, like the cached invocation counter. */
+	std::string state;
+	/* Size of the chunks a profile range is read in, in seconds and in entries. 0 reads the range at once. */
+	uint32_t chunk = 86400;
+	uint32_t rows = 1000;
+	/* Directory the profiles are decoded to as typed columns, empty doesn't decode. */
+	std::string decode;
+	/* Directory of the store the rows of the profiles are appended to, empty doesn't store them. */
+	std::string store;
+	/* Seconds of history of the stored profiles which are checked for missing rows, 0 doesn't check. */
+	uint32_t backfill = 0;
+
+	CGXByteBuffer password;
+	CGXByteBuffer ekey;
+    CGXByteBuffer akey;
+	/* System title of the client, empty uses the default one. */
+	CGXByteBuffer title;
+
+	std::vector<struct element> elements;
+};
+
+/* Options of the fleet daemon. */
+struct fleet_option {
+	/* Number of worker threads. */
+	unsigned int workers = 4;
+	/* Seconds between two polling cycles, 0 means run one cycle and exit. */
+	unsigned int interval = 0;
+	/* Milliseconds to open a TCP/IP connection. */
+	int connect = 10000;
+	/* When failed meters are polled again in the cycle. */
+	CGXRetryPolicy retry;
+	/* File of the keys of the meters, empty takes the keys of the fleet file. */
+	std::string keys;
+};
+
+/* Counters of a polling cycle. */
+struct session_stat {
+	unsigned long meters = 0;
+	unsigned long failures = 0;
+	unsigned long elements = 0;
+};
+
+/* Get the part of the device string which identifies the physical line, without its settings. */
+std::string device_port(const std::string& device);
+
+/* Split a device string like tcp://host:port, returns false if it is not a valid TCP/IP device. */
+bool device_tcp(const std::string& device, std::string& host, unsigned short& port);
+
+/* Read all elements of a meter, the results are appended to line.
+ * A connected socket of a TCP/IP device can be given, the session closes it.
+ * With a retry policy a rejected request is not retried in the session.
+ * The keys of a key store are used instead of the keys of the parameters.
+ * Returns -1 if the device can't be opened, the error of the link layer if the
+ * association fails, or the first error of an element which may go away by trying again. */
+int session_run(struct parameter& p, std::string& line, struct session_stat& st, int socket = -1, const CGXRetryPolicy *retry = nullptr, const CGXKeyStore::Keys *keys = nullptr);
+
+/* Compile the selector of a profile by range or by entry. Selected is the encoded array of
+ * the capture objects of its columns for a read by range, empty reads all columns. */
+void profile_compile(struct element& e, uint8_t select, const std::string& selected = std::string());
+
+/* Get the compiled selector of a profile by entry, entries count from 1 and to 0 means the last entry. */
+void profile_entry(struct element& e, CGXByteBuffer& value, uint32_t from, uint32_t to);
+
+/* Get the compiled selector of a profile by a range of capture times, in seconds since 1970. */
+void profile_range(struct element& e, CGXByteBuffer& value, long long from, long long to);
+
+/* Append the wanted columns of a row of a profile which was read with the columns from columns[0] on.
+ * Returns false if the row can't be walked. */
+bool profile_row(const unsigned char *data, unsigned long size, const std::vector<uint16_t>& columns, std::string& row);
+
+/* Get the key of the mark of an incremental profile in the state file. */
+std::string profile_key(const struct element& e);
+
+/* Get the range of a profile element, an incremental profile by range starts after its mark.
+ * The to entry 0 means the last entry. Returns false if the whole buffer is read. */
+bool profile_bounds(const std::map<std::string, std::string>& state, const struct element& e, long long& from, long long& to);
+
+/* Get the range of an incremental profile by entry from the entries in use of its buffer and its size.
+ * The capture time of the last row is used when the buffer is full, as then each capture moves the entries.
+ * Returns the select of the read, 0 if there are no new rows and -1 if a full buffer has no capture time. */
+int profile_resync(const std::map<std::string, std::string>& state, const struct element& e, long long entries, long long size, long long& from, long long& to);
+
+/* Get the last row of a result, its capture time when it is read by range and its entry when by entry.
+ * base is the entry before its first row. Returns false if there are no rows or the last has no capture time. */
+bool profile_last(const struct element& e, const std::string& result, long long base, long long& last);
+
+/* Move the mark of an incremental profile past the rows of a result, base is the entry before its first row.
+ * Returns false if there are no new rows or the mark can't be found in them. */
+bool profile_advance(const struct element& e, const std::string& result, long long base, std::map<std::string, std::string>& marks);
+
+/* Get the gaps of the capture times of a profile from from on, the times are sorted.
+ * Each gap is the range of a read by range which gets the missing rows. */
+void profile_gaps(std::vector<long long>& times, long long period, long long from, std::vector<std::pair<long long, long long>>& gaps);
+
+/* Write the meters and the options of a fleet as a binary table, the selectors of the elements are compiled.
+ * Returns 0 or the system error. */
+int fleet_compile(std::vector<struct parameter>& fleet, const struct fleet_option& o, const char *path);
+
+/* Load a fleet from a binary table, the file is mapped and the text format is not parsed.
+ * Returns 1 if it is loaded, 0 if the file is not a table and -1 if the table is damaged. */
+int fleet_load(const char *path, std::vector<struct parameter>& fleet, struct fleet_option& o);
+
+/* Get the key encrypting key of a key file from the hex in the GATHER_KEK environment variable.
+ * Returns false if it is not set or not a key of 16, 24 or 32 bytes. */
+bool fleet_kek(std::string& kek);
+
+/* Run the fleet daemon. */
+int fleet_run(std::vector<struct parameter>& fleet, const struct fleet_option& o);
+
+#endif //GATHER_H
@@ -0,0 +1,65 @@
+#ifndef GXHDLC_H
+#define GXHDLC_H
+
+#include <vector>
+#include <deque>
+
+//Poll/final bit of the control field.
+#define HDLC_FRAME_FINAL 0x10
+
+//Collects HDLC frames (IEC 62056-46) from a byte stream.
+//The frame length is taken from the frame format field, so a frame is
+//complete as soon as its last byte is received. HCS and FCS are checked
+//before the frame is handed to the DLMS parser, corrupt frames are dropped.
+class CGXHdlcAssembler
+{
+    enum
+    {
+        //Waiting for the opening flag.
+        STATE_HUNT,
+        //Waiting for the frame format field.
+        STATE_FORMAT,
+        //Waiting for the rest of the frame.
+        STATE_BODY
+    } m_State;
+    //Bytes of the frame under construction, including the flags.
+    std::vector<unsigned char> m_Frame;
+    //Size of the frame under construction, including the flags.
+    unsigned short m_Size;
+    std::deque<std::vector<unsigned char> > m_Ready;
+    unsigned long m_Dropped;
+
+    //Check HCS and FCS of a complete frame.
+    bool Check();
+public:
+    CGXHdlcAssembler();
+
+    //Forget partial and queued frames.
+    void Reset();
+
+    //Feed received bytes. Returns the number of frames completed.
+    int Push(const unsigned char* data, unsigned long size);
+
+    //Get next complete frame. Returns false if there is none.
+    bool Pop(std::vector<unsigned char>& frame);
+
+    //Number of complete frames waiting.
+    unsigned long Count() const
+    {
+        return (unsigned long)m_Ready.size();
+    }
+
+    //Number of frames dropped because of a bad check sequence.
+    unsigned long Dropped() const
+    {
+        return m_Dropped;
+    }
+
+    //Get the control field of a complete frame.
+    static unsigned char GetControl(const std::vector<unsigned char>& frame);
+
+    //Table-driven CRC-16/X.25 used for HCS and FCS.
+    static unsigned short Crc(unsigned short crc, const unsigned char* data, unsigned long size);
+};
+
+#endif //GXHDLC_H
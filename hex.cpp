@@ -0,0 +1,89 @@
+#include "hex.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GX_HEX_SIMD
+#include <immintrin.h>
+#endif
+
+static const char GX_HEX_DIGITS[] = "0123456789ABCDEF";
+
+static void GXEncodeScalar(const unsigned char* data, size_t size, char* out)
+{
+    for (size_t i = 0; i != size; ++i)
+    {
+        out[2 * i] = GX_HEX_DIGITS[data[i] >> 4];
+        out[2 * i + 1] = GX_HEX_DIGITS[data[i] & 0xF];
+    }
+}
+
+#ifdef GX_HEX_SIMD
+
+//The nibbles of each byte are looked up in the digits with a shuffle
+//and the high and the low digits are interleaved.
+__attribute__((target("ssse3")))
+static size_t GXEncodeSsse3(const unsigned char* data, size_t size, char* out)
+{
+    const __m128i digits = _mm_loadu_si128((const __m128i*)GX_HEX_DIGITS);
+    const __m128i mask = _mm_set1_epi8(0xF);
+    size_t i = 0;
+    for (; size - i >= 16; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(v, mask));
+        _mm_storeu_si128((__m128i*)(out + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i*)(out + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    return i;
+}
+
+//Same as SSSE3 on 32 bytes. The interleave works in 128 bit lanes,
+//so the lanes are put back in order before they are stored.
+__attribute__((target("avx2")))
+static size_t GXEncodeAvx2(const unsigned char* data, size_t size, char* out)
+{
+    const __m256i digits = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)GX_HEX_DIGITS));
+    const __m256i mask = _mm256_set1_epi8(0xF);
+    size_t i = 0;
+    for (; size - i >= 32; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i hi = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+        __m256i lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(v, mask));
+        __m256i first = _mm256_unpacklo_epi8(hi, lo);
+        __m256i second = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i*)(out + 2 * i), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256((__m256i*)(out + 2 * i + 32), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    return i;
+}
+
+#endif //GX_HEX_SIMD
+
+void CGXHex::Encode(const unsigned char* data, size_t size, char* out)
+{
+    size_t done = 0;
+#ifdef GX_HEX_SIMD
+    //Short values, like most registers, are not worth the check.
+    if (size >= 16)
+    {
+        static const int level = __builtin_cpu_supports("avx2") ? 2 : (__builtin_cpu_supports("ssse3") ? 1 : 0);
+        if (level == 2)
+        {
+            done = GXEncodeAvx2(data, size, out);
+        }
+        if (level != 0)
+        {
+            done += GXEncodeSsse3(data + done, size - done, out + 2 * done);
+        }
+    }
+#endif
+    GXEncodeScalar(data + done, size - done, out + 2 * done);
+}
+
+void CGXHex::Append(const unsigned char* data, size_t size, std::string& out)
+{
+    size_t pos = out.size();
+    out.resize(pos + 2 * size);
+    Encode(data, size, &out[pos]);
+}
@@ -0,0 +1,20 @@
+#ifndef GXHEX_H
+#define GXHEX_H
+
+#include <stddef.h>
+#include <string>
+
+//Encodes bytes as upper case hex, the way the results are printed.
+//Blocks of 32 or 16 bytes are encoded with AVX2 or SSSE3 when the CPU has
+//them, the rest byte by byte from a table.
+class CGXHex
+{
+public:
+    //Encode size bytes of data, out gets 2 * size characters and no terminator.
+    static void Encode(const unsigned char* data, size_t size, char* out);
+
+    //Append the hex of size bytes of data to a string.
+    static void Append(const unsigned char* data, size_t size, std::string& out);
+};
+
+#endif //GXHEX_H
@@ -0,0 +1,134 @@
+#include <errno.h>
+#include <map>
+#include <sys/stat.h>
+#include "keystore.h"
+#include "state.h"
+#include "dlms/include/GXCipher.h"
+#include "dlms/include/GXBytebuffer.h"
+#include "dlms/include/errorcodes.h"
+
+//Keys of a meter before they are wrapped: system title, block cipher key,
+//authentication key, length of the password and the password, padded with
+//zeros to a multiple of 8 bytes.
+#define GX_KEYS_SIZE 41
+
+//Nanoseconds of the modification time of a file.
+#if defined(_WIN32) || defined(_WIN64)
+#define GX_MTIME_NSEC(st) 0
+#elif defined(__APPLE__)
+#define GX_MTIME_NSEC(st) (st).st_mtimespec.tv_nsec
+#else
+#define GX_MTIME_NSEC(st) (st).st_mtim.tv_nsec
+#endif
+
+CGXKeyStore::CGXKeyStore() : m_Modified(0), m_ModifiedNsec(0), m_Size(0), m_Inode(0)
+{
+}
+
+int CGXKeyStore::Unwrap(const std::string& kek, const std::string& value, Keys& keys)
+{
+    CGXByteBuffer input, key, reply;
+    if (input.SetHexString(value) != 0 || input.GetSize() < 8 + GX_KEYS_SIZE)
+    {
+        return DLMS_ERROR_CODE_INVALID_PARAMETER;
+    }
+    key.Set(kek.data(), (unsigned long)kek.size());
+    if (CGXCipher::DecryptAesKeyWrapping(input, key, reply) != 0 || reply.GetSize() < GX_KEYS_SIZE)
+    {
+        return DLMS_ERROR_CODE_INVALID_PARAMETER;
+    }
+    const char* data = (const char*)reply.GetData();
+    unsigned char length = (unsigned char)data[40];
+    if (GX_KEYS_SIZE + (unsigned long)length > reply.GetSize())
+    {
+        return DLMS_ERROR_CODE_INVALID_PARAMETER;
+    }
+    keys.systemTitle.assign(data, 8);
+    keys.blockCipherKey.assign(data + 8, 16);
+    keys.authenticationKey.assign(data + 24, 16);
+    keys.password.assign(data + GX_KEYS_SIZE, length);
+    return 0;
+}
+
+int CGXKeyStore::Wrap(const std::string& kek, const Keys& keys, std::string& value)
+{
+    CGXByteBuffer input, key, reply;
+    if (keys.systemTitle.size() != 8 || keys.blockCipherKey.size() != 16 ||
+        keys.authenticationKey.size() != 16 || keys.password.size() > 255)
+    {
+        return DLMS_ERROR_CODE_INVALID_PARAMETER;
+    }
+    std::string plain = keys.systemTitle + keys.blockCipherKey + keys.authenticationKey;
+    plain.push_back((char)keys.password.size());
+    plain.append(keys.password);
+    plain.append((8 - plain.size() % 8) % 8, '\0');
+    input.Set(plain.data(), (unsigned long)plain.size());
+    key.Set(kek.data(), (unsigned long)kek.size());
+    int ret = CGXCipher::EncryptAesKeyWrapping(input, key, reply);
+    if (ret == 0)
+    {
+        value = reply.ToHexString(0, reply.GetSize(), false);
+    }
+    return ret;
+}
+
+int CGXKeyStore::Load(const std::string& path, const std::string& kek)
+{
+    int ret;
+    struct stat st;
+    std::map<std::string, std::string> values;
+    std::unordered_map<std::string, Keys> keys;
+    if (stat(path.c_str(), &st) != 0)
+    {
+        return errno;
+    }
+    if ((ret = CGXStateFile::Load(path, values)) != 0)
+    {
+        return ret;
+    }
+    keys.reserve(values.size());
+    for (std::map<std::string, std::string>::iterator it = values.begin(); it != values.end(); ++it)
+    {
+        if ((ret = Unwrap(kek, it->second, keys[it->first])) != 0)
+        {
+            return ret;
+        }
+    }
+    m_Path = path;
+    m_Kek = kek;
+    m_Modified = st.st_mtime;
+    m_ModifiedNsec = GX_MTIME_NSEC(st);
+    m_Size = st.st_size;
+    m_Inode = st.st_ino;
+    m_Keys.swap(keys);
+    return 0;
+}
+
+int CGXKeyStore::Reload()
+{
+    struct stat st;
+    if (m_Path.empty() || (stat(m_Path.c_str(), &st) == 0 && st.st_mtime == m_Modified &&
+        GX_MTIME_NSEC(st) == m_ModifiedNsec && st.st_size == m_Size && st.st_ino == m_Inode))
+    {
+        return 0;
+    }
+    std::string path = m_Path, kek = m_Kek;
+    return Load(path, kek);
+}
+
+const CGXKeyStore::Keys* CGXKeyStore::Get(const std::string& meter) const
+{
+    std::unordered_map<std::string, Keys>::const_iterator it = m_Keys.find(meter);
+    return it == m_Keys.end() ? NULL : &it->second;
+}
+
+int CGXKeyStore::Put(const std::string& path, const std::string& kek, const std::string& meter, const Keys& keys)
+{
+    int ret;
+    std::string value;
+    if ((ret = Wrap(kek, keys, value)) != 0)
+    {
+        return ret;
+    }
+    return CGXStateFile::Update(path, meter, value);
+}
@@ -0,0 +1,65 @@
+#ifndef GXKEYSTORE_H
+#define GXKEYSTORE_H
+
+#include <time.h>
+#include <string>
+#include <unordered_map>
+
+//Keys of each meter of a fleet, kept in a file of their own.
+//The file has a line name=value for each meter, like a state file. The value
+//is the hex of the keys of the meter wrapped with AES key wrap (RFC 3394)
+//under a key encrypting key, so the file can be read only with that key.
+//The keys are unwrapped once when the file is loaded, a session copies the
+//bytes into its ciphering without parsing hex.
+class CGXKeyStore
+{
+public:
+    struct Keys
+    {
+        //System title of the client, 8 bytes.
+        std::string systemTitle;
+        //Block cipher and authentication keys, 16 bytes.
+        std::string blockCipherKey;
+        std::string authenticationKey;
+        //Password of the low level authentication, can be empty.
+        std::string password;
+    };
+
+private:
+    std::string m_Path;
+    std::string m_Kek;
+    //Modification time, size and inode of the loaded file, the time alone
+    //has only one second resolution on some systems.
+    time_t m_Modified;
+    long m_ModifiedNsec;
+    long long m_Size;
+    unsigned long long m_Inode;
+    std::unordered_map<std::string, Keys> m_Keys;
+
+    static int Unwrap(const std::string& kek, const std::string& value, Keys& keys);
+    static int Wrap(const std::string& kek, const Keys& keys, std::string& value);
+public:
+    CGXKeyStore();
+
+    //Load the keys of a file, kek is the key encrypting key of 16, 24 or 32 bytes.
+    //Returns 0 or the system error, DLMS_ERROR_CODE_INVALID_PARAMETER if the keys of a meter can't be unwrapped.
+    int Load(const std::string& path, const std::string& kek);
+
+    //Load the file again if it has changed. The keys loaded before are kept if it fails.
+    //Returns 0 or the error of Load.
+    int Reload();
+
+    //Get the keys of a meter by its name. Returns NULL if the meter has no keys.
+    const Keys* Get(const std::string& meter) const;
+
+    size_t GetCount() const
+    {
+        return m_Keys.size();
+    }
+
+    //Wrap the keys of a meter and put them into a key file, the other meters are kept.
+    //Returns 0 or the system error.
+    static int Put(const std::string& path, const std::string& kek, const std::string& meter, const Keys& keys);
+};
+
+#endif //GXKEYSTORE_H
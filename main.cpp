@@ -5,39 +5,21 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <set>
 #include <time.h>
+#include "gather.h"
 #include "communication.h"
+#include "store.h"
 #include "dlms/include/GXDLMSCommon.h"
 #include "dlms/include/GXBytebuffer.h"
 
-struct element {
-    uint16_t classID = 0;
-    std::string obis;
-    uint8_t index = 0;
-	CGXByteBuffer selects;
-};
-
-struct parameter {
-	std::string device;
-
-	uint8_t mode = 4;
-    uint8_t client = 16;
-    uint16_t logical = 1;
-    uint16_t physical = 0;
-	DLMS_AUTHENTICATION level = DLMS_AUTHENTICATION_NONE;
-	bool negotiate = false;
-
-	CGXByteBuffer password;
-	CGXByteBuffer ekey;
-    CGXByteBuffer akey;
-
-	std::vector<struct element> elements;
-};
-
 static void arg_error(char *name) {
 	static char *help_string =
 	"%s: Valid parameters are:\n"
 	"  -d <device> - specify the serial device, like /dev/ttyS1:9600:8Even0 in unix or COM3:9600:8Even0 in windows\n"
+	"               any baud rate can be used, append ':lowlatency' to enable the low latency mode of USB adapters\n"
+	"               or a TCP/IP connection, like tcp://192.168.1.10:4059, the default port is 4059\n"
+	"  -I <interface> - specify the interface type, value is one of hdlc or wrapper, default is hdlc\n"
 	"  -m <mode> - specify the address mode, value is one of 1, 2 or 4\n"
 	"  -c <client> - specify the client address, range is 1~127, default is 16\n"
 	"  -l <logical> - specify the logical address, range is 1~16383, default is 1\n"
@@ -51,13 +33,33 @@ static void arg_error(char *name) {
 	"  -o <obis> - specify the obis\n"
 	"  -t <attribute> - specify the attribute id\n"
 	"  -r <from-to> - specify the select parameter, can be entrys(0~65535) or timestep(>=946684800)\n"
+	"               or auto to read the new rows of a profile since the last read, auto-entry to count them by entry\n"
+	"  -k <columns> - specify the columns of a profile to read, like 1,3 or 1-4, default is all\n"
 	"  -f <file> - specify a config file\n"
+	"  -D <file> - run as a daemon, polling all meters defined in the fleet file or fleet table\n"
+	"  -C <file> <table> - check a fleet file and compile it into a fleet table, which starts without parsing\n"
+	"  -K <keys> <meter> <title> <ekey> <akey> [password] - put the keys of a meter into a key file of a fleet,\n"
+	"               they are wrapped with the hex key in the GATHER_KEK environment variable\n"
+	"  -q <store> <meter> <obis> <attribute> [from-to] - print the stored rows of a profile, optionally\n"
+	"               of the capture times from to to in seconds since 1970, the meter is its name in the fleet\n"
+	"               file or its line and address on the command line, like /dev/ttyS1#1.17\n"
 	"  -h - get this message\n";
 
     fprintf(stderr, help_string, name);
     exit(1);
 }
 
+/* Check if a device string is a serial device or a TCP/IP connection. */
+static bool check_device(const std::string& device) {
+	std::string host;
+	unsigned short port;
+
+	if(device.compare(0, 6, "tcp://") == 0) {
+		return device_tcp(device, host, port);
+	}
+	return (device.size() >= 15);
+}
+
 static void split(const std::string& s, std::vector<long long>& sv, const char flag = ' ') {
     sv.clear();
     std::istringstream iss(s);
@@ -69,7 +71,29 @@ static void split(const std::string& s, std::vector<long long>& sv, const char f
     return;
 }
 
-static void prase_file(char *file, struct parameter& p) {
+/* Prase the columns of a profile, like 1,3 or 1-4, the columns are sorted. */
+static bool prase_columns(const std::string& s, std::vector<uint16_t>& columns) {
+	std::istringstream iss(s);
+	std::string temp;
+
+	columns.clear();
+	while (std::getline(iss, temp, ',')) {
+		std::vector<long long> sv;
+		split(temp, sv, '-');
+		if((sv.size() < 1) || (sv.size() > 2) || (sv[0] < 1) || (sv.back() < sv[0]) || (sv.back() > 65535)) {
+			return false;
+		}
+		for(long long c = sv[0]; c <= sv.back(); c++) {
+			columns.push_back(c);
+		}
+	}
+	std::sort(columns.begin(), columns.end());
+	columns.erase(std::unique(columns.begin(), columns.end()), columns.end());
+	return !columns.empty();
+}
+
+/* Read a config file, each valid line is returned as a (tag, value) pair. */
+static void prase_lines(char *file, std::vector<std::pair<std::string, std::string>>& items) {
 	/* Read config file. */
 	std::ifstream in(file);
 	if(!in.is_open()) {
@@ -144,284 +168,423 @@ static void prase_file(char *file, struct parameter& p) {
 				value.erase(value.find_last_not_of(" ") + 1);
 			}
 
-			if(tag == "device") { /* Get the device. */
-				if(value.size() < 15) {
-					fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
-					exit(1);
-				}
-				p.device = value;
+			items.push_back(std::make_pair(tag, value));
+		}
+	}
+
+    return;
+}
+
+/* Prase one config item, returns false if the tag is unknown. */
+static bool prase_tag(const std::string& tag, const std::string& value, struct parameter& p) {
+	if(tag == "device") { /* Get the device. */
+		if(!check_device(value)) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		p.device = value;
+	}
+	else if(tag == "interface") { /* Get the interface type. */
+		if(value == "hdlc") {
+			p.interfaceType = DLMS_INTERFACE_TYPE_HDLC;
+		}
+		else if(value == "wrapper") {
+			p.interfaceType = DLMS_INTERFACE_TYPE_WRAPPER;
+		}
+		else {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+	}
+	else if(tag == "mode") { /* Get the address mode. */
+		if((std::stoi(value.data()) != 1) && (std::stoi(value.data()) != 2) && (std::stoi(value.data()) != 4)) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		else {
+			p.mode = std::stoi(value.data());
+		}
+	}
+	else if(tag == "client") { /* Get the client address. */
+		if((std::stoi(value.data()) < 1) || (std::stoi(value.data()) > 127)) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		else {
+			p.client = std::stoi(value.data());
+		}
+	}
+	else if(tag == "logical") { /* Get the logical address. */
+		if((std::stoi(value.data()) < 1) || (std::stoi(value.data()) > 16383)) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		else {
+			p.logical = std::stoi(value.data());
+		}
+	}
+	else if(tag == "physical") { /* Get the physical address. */
+		if((std::stoi(value.data()) < 0) || (std::stoi(value.data()) > 16383)) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		else {
+			p.physical = std::stoi(value.data());
+		}
+	}
+	else if(tag == "level") { /* Get the access level. */
+		if(std::stoi(value.data()) == 0){
+			p.level = DLMS_AUTHENTICATION_NONE;
+		}
+		else if(std::stoi(value.data()) == 1){
+			p.level = DLMS_AUTHENTICATION_LOW;
+		}
+		else if(std::stoi(value.data()) == 5){
+			p.level = DLMS_AUTHENTICATION_HIGH_GMAC;
+		}
+		else{
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+	}
+	else if(tag == "negotiate") { /* Get the negotiate state. */
+		if(value == "true") {
+			p.negotiate = true;
+		}
+		else if(value == "false") {
+			p.negotiate = false;
+		}
+		else {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+	}
+	else if(tag == "info") { /* Get the max information field length of HDLC. */
+		if((std::stoi(value.data()) < 32) || (std::stoi(value.data()) > 2030)) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		else {
+			p.info = std::stoi(value.data());
+		}
+	}
+	else if(tag == "frames") { /* Get the window size of HDLC. */
+		if((std::stoi(value.data()) < 1) || (std::stoi(value.data()) > 7)) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		else {
+			p.frames = std::stoi(value.data());
+		}
+	}
+	else if(tag == "window") { /* Get the window size of general block transfer. */
+		if((std::stoi(value.data()) < 0) || (std::stoi(value.data()) > 63)) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		else {
+			p.window = std::stoi(value.data());
+		}
+	}
+	else if(tag == "counter") { /* Get the OBIS of the invocation counter. */
+		std::vector<long long> sv;
+		split(value, sv, '.');
+		if(sv.size() != 6) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		for (const auto& s : sv) {
+			if((s < 0) || (s > 255)) {
+				fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+				exit(1);
 			}
-			else if(tag == "mode") { /* Get the address mode. */
-				if((std::stoi(value.data()) != 1) && (std::stoi(value.data()) != 2) && (std::stoi(value.data()) != 4)) {
-					fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
-					exit(1);
-				}
-				else {
-					p.mode = std::stoi(value.data());
-				}
+		}
+		p.counter = value;
+	}
+	else if(tag == "state") { /* Get the state directory. */
+		if(value.empty()) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		p.state = value;
+	}
+	else if(tag == "chunk") { /* Get the chunk sizes of profile ranges. */
+		std::istringstream iss(value);
+		long long seconds = -1, rows = -1;
+		iss >> seconds >> rows;
+		if((seconds < 0) || (seconds > 31536000) || (rows < 0) || (rows > 65535)) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		p.chunk = seconds;
+		p.rows = rows;
+	}
+	else if(tag == "decode") { /* Get the directory of the decoded profiles. */
+		if(value.empty()) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		p.decode = value;
+	}
+	else if(tag == "store") { /* Get the directory of the store. */
+		if(value.empty()) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		p.store = value;
+	}
+	else if(tag == "backfill") { /* Get the history checked for missing rows. */
+		if(value.empty() || (value.find_first_not_of("0123456789") != std::string::npos) ||
+			(value.size() > 9) || (std::stol(value) > 31536000)) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		p.backfill = std::stol(value);
+	}
+	else if(tag == "title") { /* Get the system title of the client. */
+		if(value.size() != 16) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		p.title.Clear();
+		p.title.SetHexString(value.data());
+	}
+	else if(tag == "password") { /* Get the password. */
+		if((value.size() < 16) || (value.size() % 2)) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		p.password.Clear();
+		p.password.SetHexString(value.data());
+	}
+	else if(tag == "ekey") { /* Get the encryption key. */
+		if(value.size() != 32) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		p.ekey.Clear();
+		p.ekey.SetHexString(value.data());
+	}
+	else if(tag == "akey") { /* Get the authentication key. */
+		if(value.size() != 32) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		p.akey.Clear();
+		p.akey.SetHexString(value.data());
+	}
+	else if(tag == "element") { /* Get element. */
+		/* Split value with ' '. */
+		std::vector<std::string> line;
+		line.clear();
+		std::istringstream iss(value);
+		std::string temp;
+		while (std::getline(iss, temp, ' ')) {
+			line.push_back(temp);
+		}
+		if((line.size() < 3) || (line.size() > 5)) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+
+		struct element e;
+		std::vector<std::string>::iterator iter = line.begin();
+
+		/* Prease class ID. */
+		std::string id = *iter;
+		if(!id.empty()) {
+			id.erase(0,id.find_first_not_of(" "));
+		}
+		if(!id.empty()) {
+			id.erase(id.find_last_not_of(" ") + 1);
+		}
+		if((std::stoi(id) < 1) || (std::stoi(id) > 16383)) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		else {
+			e.classID = std::stoi(id);
+		}
+
+		/* Prease OBIS. */
+		++ iter;
+		std::string obis = *iter;
+		if(!obis.empty()) {
+			obis.erase(0,obis.find_first_not_of(" "));
+		}
+		if(!obis.empty()) {
+			obis.erase(obis.find_last_not_of(" ") + 1);
+		}
+		std::vector<long long> sv;
+		split(obis, sv, '.');
+		if(sv.size() != 6) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		for (const auto& s : sv) {
+			if((s < 0) || (s > 255)) {
+				fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+				exit(1);
 			}
-			else if(tag == "client") { /* Get the client address. */
-				if((std::stoi(value.data()) < 1) || (std::stoi(value.data()) > 127)) {
-					fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
-					exit(1);
-				}
-				else {
-					p.client = std::stoi(value.data());
-				}
+		}
+		e.obis = obis;
+
+		/* Prease attribute. */
+		++ iter;
+		std::string attr = *iter;
+		if(!attr.empty()) {
+			attr.erase(0,attr.find_first_not_of(" "));
+		}
+		if(!attr.empty()) {
+			attr.erase(attr.find_last_not_of(" ") + 1);
+		}
+		if((std::stoi(attr) < 1) || (std::stoi(attr) > 32)) {
+			fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+			exit(1);
+		}
+		else {
+			e.index = std::stoi(attr);
+		}
+
+		/* Prease selects. */
+		if(line.size() >= 4) {
+			++ iter;
+			std::string selects = *iter;
+			if(!selects.empty()) {
+				selects.erase(0,selects.find_first_not_of(" "));
 			}
-			else if(tag == "logical") { /* Get the logical address. */
-				if((std::stoi(value.data()) < 1) || (std::stoi(value.data()) > 16383)) {
-					fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
-					exit(1);
-				}
-				else {
-					p.logical = std::stoi(value.data());
-				}
+			if(!selects.empty()) {
+				selects.erase(selects.find_last_not_of(" ") + 1);
 			}
-			else if(tag == "physical") { /* Get the physical address. */
-				if((std::stoi(value.data()) < 0) || (std::stoi(value.data()) > 16383)) {
-					fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
-					exit(1);
-				}
-				else {
-					p.physical = std::stoi(value.data());
-				}
+			/* Incremental profile, the selector is built from the mark before each read. */
+			if((selects == "auto") || (selects == "auto-entry")) {
+				e.select = selects == "auto" ? PROFILE_BY_RANGE : PROFILE_BY_ENTRY;
+				e.mark = true;
 			}
-			else if(tag == "level") { /* Get the access level. */
-				if(std::stoi(value.data()) == 0){
-					p.level = DLMS_AUTHENTICATION_NONE;
-				}
-				else if(std::stoi(value.data()) == 1){
-					p.level = DLMS_AUTHENTICATION_LOW;
-				}
-				else if(std::stoi(value.data()) == 5){
-					p.level = DLMS_AUTHENTICATION_HIGH_GMAC;
-				}
-				else{
+			else {
+				if(selects.size() < 3) {
 					fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
 					exit(1);
 				}
-			}
-			else if(tag == "negotiate") { /* Get the negotiate state. */
-				if(value == "true") {
-					p.negotiate = true;
-				}
-				else if(value == "false") {
-					p.negotiate = false;
-				}
-				else {
+				std::vector<long long> sv;
+				split(selects, sv, '-');
+				if(sv.size() != 2) {
 					fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
 					exit(1);
 				}
-			}
-			else if(tag == "password") { /* Get the password. */
-				if((value.size() < 16) || (value.size() % 2)) {
+				if((sv[0] < 0) || (sv[1] < 0)) {
 					fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
 					exit(1);
 				}
-				p.password.SetHexString(value.data());
-			}
-			else if(tag == "ekey") { /* Get the encryption key. */
-				if(value.size() != 32) {
+				if(sv[1] < sv[0]) {
 					fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
 					exit(1);
 				}
-				p.ekey.SetHexString(value.data());
-			}
-			else if(tag == "akey") { /* Get the authentication key. */
-				if(value.size() != 32) {
-					fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
-					exit(1);
+				if((sv[0] < 65536) && (sv[1] < 65536)) {
+					e.select = PROFILE_BY_ENTRY;
 				}
-				p.akey.SetHexString(value.data());
-			}
-			else if(tag == "element") { /* Get element. */
-				/* Split value with ' '. */
-				std::vector<std::string> line;
-				line.clear();
-				std::istringstream iss(value);
-				std::string temp;
-				while (std::getline(iss, temp, ' ')) {
-					line.push_back(temp);
+				else if((sv[0] >= 946684800) && (sv[1] >= 946684800)) {
+					e.select = PROFILE_BY_RANGE;
 				}
-				if((line.size() < 3) || (line.size() > 4)) {
+				else {
 					fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
 					exit(1);
 				}
+				e.from = sv[0];
+				e.to = sv[1];
+			}
+		}
 
-				struct element e;
-				std::vector<std::string>::iterator iter = line.begin();
+		/* Prease columns. */
+		if(line.size() == 5) {
+			++ iter;
+			if(!prase_columns(*iter, e.columns)) {
+				fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
+				exit(1);
+			}
+		}
 
-				/* Prease class ID. */
-				std::string id = *iter;
-				if(!id.empty()) {
-					id.erase(0,id.find_first_not_of(" "));
-				}
-				if(!id.empty()) {
-					id.erase(id.find_last_not_of(" ") + 1);
-				}
-				if((std::stoi(id) < 1) || (std::stoi(id) > 16383)) {
-					fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
-					exit(1);
-				}
-				else {
-					e.classID = std::stoi(id);
-				}
+		/* Push the element to vector. */
+		p.elements.push_back(e);
+	}
+	else {
+		return false;
+	}
 
-				/* Prease OBIS. */
-				++ iter;
-				std::string obis = *iter;
-				if(!obis.empty()) {
-					obis.erase(0,obis.find_first_not_of(" "));
-				}
-				if(!obis.empty()) {
-					obis.erase(obis.find_last_not_of(" ") + 1);
-				}
-				std::vector<long long> sv;
-				split(obis, sv, '.');
-				if(sv.size() != 6) {
-					fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
-					exit(1);
-				}
-				for (const auto& s : sv) {
-					if((s < 0) || (s > 255)) {
-						fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
-						exit(1);
-					}
-				}
-				e.obis = obis;
+	return true;
+}
 
-				/* Prease attribute. */
-				++ iter;
-				std::string attr = *iter;
-				if(!attr.empty()) {
-					attr.erase(0,attr.find_first_not_of(" "));
-				}
-				if(!attr.empty()) {
-					attr.erase(attr.find_last_not_of(" ") + 1);
-				}
-				if((std::stoi(attr) < 1) || (std::stoi(attr) > 32)) {
-					fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
-					exit(1);
-				}
-				else {
-					e.index = std::stoi(attr);
-				}
+static void prase_file(char *file, struct parameter& p) {
+	std::vector<std::pair<std::string, std::string>> items;
 
-				/* Prease selects. */
-				if(line.size() == 4) {
-					++ iter;
-					std::string selects = *iter;
-					if(!selects.empty()) {
-						selects.erase(0,selects.find_first_not_of(" "));
-					}
-					if(!selects.empty()) {
-						selects.erase(selects.find_last_not_of(" ") + 1);
-					}
-					if(selects.size() < 3) {
-						fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
-						exit(1);
-					}
-					std::vector<long long> sv;
-					split(selects, sv, '-');
-					if(sv.size() != 2) {
-						fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
-						exit(1);
-					}
-					if((sv[0] < 0) || (sv[1] < 0)) {
-						fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
-						exit(1);
-					}
-					if(sv[1] < sv[0]) {
-						fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
-						exit(1);
-					}
-					CGXByteBuffer value;
-					value.Clear();
-					if((sv[0] < 65536) && (sv[1] < 65536)) {
-						value.SetUInt8(2);//by entry
-						value.SetUInt8(DLMS_DATA_TYPE_STRUCTURE);
-						value.SetUInt8(4);
-						//from entry
-						value.SetUInt8(DLMS_DATA_TYPE_UINT32);
-						value.SetUInt32(sv[0]);
-						//to entry
-						value.SetUInt8(DLMS_DATA_TYPE_UINT32);
-						value.SetUInt32(sv[1]);
-						//from selected value
-						value.SetUInt8(DLMS_DATA_TYPE_UINT16);
-						value.SetUInt16(0);
-						//to selected value
-						value.SetUInt8(DLMS_DATA_TYPE_UINT16);
-						value.SetUInt16(0);
-					}
-					else if((sv[0] >= 946684800) && (sv[1] >= 946684800)) {
-						value.SetUInt8(1);//by range
-						value.SetUInt8(DLMS_DATA_TYPE_STRUCTURE);
-						value.SetUInt8(4);
-						//restricting object
-						value.SetUInt8(DLMS_DATA_TYPE_STRUCTURE);
-						value.SetUInt8(4);
-						value.SetUInt8(DLMS_DATA_TYPE_UINT16);
-						value.SetUInt16(8);
-						value.SetUInt8(DLMS_DATA_TYPE_OCTET_STRING);
-						value.SetUInt8(6);
-						value.SetHexString("0000010000FF");
-						value.SetUInt8(DLMS_DATA_TYPE_INT8);
-						value.SetUInt8(2);
-						value.SetUInt8(DLMS_DATA_TYPE_UINT16);
-						value.SetUInt16(0);
-						//from
-						struct tm *from = gmtime(reinterpret_cast<const time_t *>(&sv[0]));
-						value.SetUInt8(DLMS_DATA_TYPE_OCTET_STRING);
-						value.SetUInt8(12);
-						value.SetUInt16(from->tm_year + 1900);
-						value.SetUInt8(from->tm_mon + 1);
-						value.SetUInt8(from->tm_mday);
-						value.SetUInt8(0xff);
-						value.SetUInt8(from->tm_hour);
-						value.SetUInt8(from->tm_min);
-						value.SetUInt8(from->tm_sec);
-						value.SetUInt8(0);
-						value.SetUInt16(0x8000);
-						value.SetUInt8(0);
-						//to
-						struct tm *to = gmtime(reinterpret_cast<const time_t *>(&sv[1]));
-						value.SetUInt8(DLMS_DATA_TYPE_OCTET_STRING);
-						value.SetUInt8(12);
-						value.SetUInt16(to->tm_year + 1900);
-						value.SetUInt8(to->tm_mon + 1);
-						value.SetUInt8(to->tm_mday);
-						value.SetUInt8(0xff);
-						value.SetUInt8(to->tm_hour);
-						value.SetUInt8(to->tm_min);
-						value.SetUInt8(to->tm_sec);
-						value.SetUInt8(0);
-						value.SetUInt16(0x8000);
-						value.SetUInt8(0);
-						//selected values
-						value.SetUInt8(DLMS_DATA_TYPE_ARRAY);
-						value.SetUInt8(0);
-					}
-					else {
-						fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
-						exit(1);
-					}
+	prase_lines(file, items);
+	for(std::vector<std::pair<std::string, std::string>>::iterator iter = items.begin(); iter != items.end(); iter++) {
+		if(!prase_tag(iter->first, iter->second, p)) {
+			fprintf(stderr, "Invalid config file: '%s'\n", iter->first.data());
+			exit(1);
+		}
+	}
 
-					e.selects = value;
-				}
+    return;
+}
 
-				/* Push the element to vector. */
-				p.elements.push_back(e);
-			}
-			else {
-				fprintf(stderr, "Invalid config file: '%s'\n", tag.data());
-				exit(1);
-			}
+
+/* Check if the parameters of a meter are complete. */
+static bool check_para(struct parameter& p, bool keyed = false) {
+	/* Check if the device string is valid. */
+	if(!check_device(p.device)) {
+		fprintf(stderr, "Device should be specified correctly\n");
+		return false;
+	}
+
+	/* Check if the password is valid when the access level is DLMS_AUTHENTICATION_LOW.
+	 * The keys of a fleet with a key file are checked when the meter is polled. */
+	if(!keyed && (p.level == DLMS_AUTHENTICATION_LOW)) {
+		if(p.password.GetSize() < 8) {
+			fprintf(stderr, "Password should be specified correctly\n");
+			return false;
+		}
+	}
+	/* Check if the ekey & akey is valid when the access level is DLMS_AUTHENTICATION_HIGH_GMAC. */
+	else if(!keyed && (p.level == DLMS_AUTHENTICATION_HIGH_GMAC)) {
+		if((p.ekey.GetSize() != 16) || (p.akey.GetSize() != 16)) {
+			fprintf(stderr, "Invalid ekey or akey\n");
+			return false;
 		}
 	}
 
-    return;
+	/* Check if the elements is empty. */
+	if(p.elements.size() < 1) {
+		fprintf(stderr, "At least 1 element should be specified\n");
+		return false;
+	}
+
+	/* The missing rows are found in the store, the state keeps where the last check ended. */
+	if((p.backfill != 0) && (p.store.empty() || p.state.empty())) {
+		fprintf(stderr, "Backfill needs the store and the state to be specified\n");
+		return false;
+	}
+
+	/* Check if the incremental elements are profiles and have a state directory to keep their marks. */
+	for(std::vector<struct element>::iterator iter = p.elements.begin(); iter != p.elements.end(); iter++) {
+		if(iter->mark && ((iter->classID != 7) || p.state.empty())) {
+			fprintf(stderr, "Incremental element %s should be a profile and the state should be specified\n", iter->obis.data());
+			return false;
+		}
+		/* Columns are selected with selective access, the mark of time is taken from the first column. */
+		if(!iter->columns.empty() && ((iter->classID != 7) || (iter->select == 0) ||
+			(iter->mark && (iter->select == PROFILE_BY_RANGE) && (iter->columns[0] != 1)))) {
+			fprintf(stderr, "Columns of element %s need a select parameter, auto needs column 1\n", iter->obis.data());
+			return false;
+		}
+		/* Rows of a backfilled profile are found by their capture time, the first column. */
+		if((p.backfill != 0) && (iter->classID == 7) && (iter->index == 2) && !iter->columns.empty() && (iter->columns[0] != 1)) {
+			fprintf(stderr, "Columns of element %s need column 1 for backfill\n", iter->obis.data());
+			return false;
+		}
+	}
+
+	return true;
 }
 
 static void prase_para(int argc, char *argv[], struct parameter& p) {
@@ -444,13 +607,31 @@ static void prase_para(int argc, char *argv[], struct parameter& p) {
 					fprintf(stderr, "Invalid argument: '%s'\n", argv[i]);
 					arg_error(argv[0]);
 				}
-				if(strlen(argv[i]) < 15) {
+				if(!check_device(argv[i])) {
 					fprintf(stderr, "Invalid argument: '%s'\n", argv[i]);
 					arg_error(argv[0]);
 				}
 				p.device = argv[i];
 				break;
 			}
+			case 'I': { /* Get the interface type. */
+				i++;
+				if (i == argc) {
+					fprintf(stderr, "Invalid argument: '%s'\n", argv[i]);
+					arg_error(argv[0]);
+				}
+				if(strcmp(argv[i], "hdlc") == 0) {
+					p.interfaceType = DLMS_INTERFACE_TYPE_HDLC;
+				}
+				else if(strcmp(argv[i], "wrapper") == 0) {
+					p.interfaceType = DLMS_INTERFACE_TYPE_WRAPPER;
+				}
+				else {
+					fprintf(stderr, "Invalid argument: '%s'\n", argv[i]);
+					arg_error(argv[0]);
+				}
+				break;
+			}
 			case 'm': { /* Get the address mode. */
 				i++;
 				if (i == argc) {
@@ -632,6 +813,12 @@ static void prase_para(int argc, char *argv[], struct parameter& p) {
 					fprintf(stderr, "Invalid argument: '%s'\n", argv[i]);
 					arg_error(argv[0]);
 				}
+				/* Incremental profile, the selector is built from the mark before each read. */
+				if((strcmp(argv[i], "auto") == 0) || (strcmp(argv[i], "auto-entry") == 0)) {
+					e.select = strcmp(argv[i], "auto") == 0 ? PROFILE_BY_RANGE : PROFILE_BY_ENTRY;
+					e.mark = true;
+					break;
+				}
 				std::vector<long long> sv;
 				split(argv[i], sv, '-');
 				if(sv.size() != 2) {
@@ -646,79 +833,30 @@ static void prase_para(int argc, char *argv[], struct parameter& p) {
 					fprintf(stderr, "Invalid argument: '%s'\n", argv[i]);
 					arg_error(argv[0]);
 				}
-				CGXByteBuffer value;
-				value.Clear();
 				if((sv[0] < 65536) && (sv[1] < 65536)) {
-					value.SetUInt8(2);//by entry
-					value.SetUInt8(DLMS_DATA_TYPE_STRUCTURE);
-					value.SetUInt8(4);
-					//from entry
-					value.SetUInt8(DLMS_DATA_TYPE_UINT32);
-					value.SetUInt32(sv[0]);
-					//to entry
-					value.SetUInt8(DLMS_DATA_TYPE_UINT32);
-					value.SetUInt32(sv[1]);
-					//from selected value
-					value.SetUInt8(DLMS_DATA_TYPE_UINT16);
-					value.SetUInt16(0);
-					//to selected value
-					value.SetUInt8(DLMS_DATA_TYPE_UINT16);
-					value.SetUInt16(0);
+					e.select = PROFILE_BY_ENTRY;
 				}
 				else if((sv[0] >= 946684800) && (sv[1] >= 946684800)) {
-					value.SetUInt8(1);//by range
-					value.SetUInt8(DLMS_DATA_TYPE_STRUCTURE);
-					value.SetUInt8(4);
-					//restricting object
-					value.SetUInt8(DLMS_DATA_TYPE_STRUCTURE);
-					value.SetUInt8(4);
-					value.SetUInt8(DLMS_DATA_TYPE_UINT16);
-					value.SetUInt16(8);
-					value.SetUInt8(DLMS_DATA_TYPE_OCTET_STRING);
-					value.SetUInt8(6);
-					value.SetHexString("0000010000FF");
-					value.SetUInt8(DLMS_DATA_TYPE_INT8);
-					value.SetUInt8(2);
-					value.SetUInt8(DLMS_DATA_TYPE_UINT16);
-					value.SetUInt16(0);
-					//from
-					struct tm *from = gmtime(reinterpret_cast<const time_t *>(&sv[0]));
-					value.SetUInt8(DLMS_DATA_TYPE_OCTET_STRING);
-					value.SetUInt8(12);
-					value.SetUInt16(from->tm_year + 1900);
-					value.SetUInt8(from->tm_mon + 1);
-					value.SetUInt8(from->tm_mday);
-					value.SetUInt8(0xff);
-					value.SetUInt8(from->tm_hour);
-					value.SetUInt8(from->tm_min);
-					value.SetUInt8(from->tm_sec);
-					value.SetUInt8(0);
-					value.SetUInt16(0x8000);
-					value.SetUInt8(0);
-					//to
-					struct tm *to = gmtime(reinterpret_cast<const time_t *>(&sv[1]));
-					value.SetUInt8(DLMS_DATA_TYPE_OCTET_STRING);
-					value.SetUInt8(12);
-					value.SetUInt16(to->tm_year + 1900);
-					value.SetUInt8(to->tm_mon + 1);
-					value.SetUInt8(to->tm_mday);
-					value.SetUInt8(0xff);
-					value.SetUInt8(to->tm_hour);
-					value.SetUInt8(to->tm_min);
-					value.SetUInt8(to->tm_sec);
-					value.SetUInt8(0);
-					value.SetUInt16(0x8000);
-					value.SetUInt8(0);
-					//selected values
-					value.SetUInt8(DLMS_DATA_TYPE_ARRAY);
-					value.SetUInt8(0);
+					e.select = PROFILE_BY_RANGE;
 				}
 				else {
 					fprintf(stderr, "Invalid argument: '%s'\n", argv[i]);
 					arg_error(argv[0]);
 				}
-				
-				e.selects = value;
+				e.from = sv[0];
+				e.to = sv[1];
+				break;
+			}
+			case 'k': { /* Get the columns of a profile. */
+				i++;
+				if (i == argc) {
+					fprintf(stderr, "Invalid argument: '%s'\n", argv[i]);
+					arg_error(argv[0]);
+				}
+				if(!prase_columns(argv[i], e.columns)) {
+					fprintf(stderr, "Invalid argument: '%s'\n", argv[i]);
+					arg_error(argv[0]);
+				}
 				break;
 			}
 			case 'f': { /* Get configs from file. */
@@ -746,179 +884,200 @@ static void prase_para(int argc, char *argv[], struct parameter& p) {
 		p.elements.push_back(e);
 	}
 
-	/* Check if the device string is valid. */
-	if(p.device.size() < 15) {
-		fprintf(stderr, "Device should be specified correctly\n");
+	if(!check_para(p)) {
 		exit(1);
 	}
 
-	/* Check if the password is valid when the access level is DLMS_AUTHENTICATION_LOW. */
-	if(p.level == DLMS_AUTHENTICATION_LOW) {
-		if(p.password.GetSize() < 8) {
-			fprintf(stderr, "Password should be specified correctly\n");
-			exit(1);
+    return;
+}
+
+/* Read a fleet file, the tags before the first 'meter' are the defaults of all meters. */
+static void prase_fleet(char *file, std::vector<struct parameter>& fleet, struct fleet_option& o) {
+	std::vector<std::pair<std::string, std::string>> items;
+	struct parameter defaults;
+	/* The name keys the state, the store and the keys of a meter. */
+	std::set<std::string> names;
+
+	prase_lines(file, items);
+	for(std::vector<std::pair<std::string, std::string>>::iterator iter = items.begin(); iter != items.end(); iter++) {
+		const std::string& tag = iter->first;
+		const std::string& value = iter->second;
+
+		if(tag == "meter") { /* Start a new meter. */
+			if(value.empty()) {
+				fprintf(stderr, "Invalid fleet file: '%s'\n", tag.data());
+				exit(1);
+			}
+			if(!names.insert(value).second) {
+				fprintf(stderr, "Meter %s is defined twice\n", value.data());
+				exit(1);
+			}
+			fleet.push_back(defaults);
+			fleet.back().name = value;
 		}
-	}
-	/* Check if the ekey & akey is valid when the access level is DLMS_AUTHENTICATION_HIGH_GMAC. */
-	else if(p.level == DLMS_AUTHENTICATION_HIGH_GMAC) {
-		if((p.ekey.GetSize() != 16) || (p.akey.GetSize() != 16)) {
-			fprintf(stderr, "Invalid ekey or akey\n");
+		else if(tag == "workers") { /* Get the number of workers. */
+			if(!fleet.empty() || (std::stoi(value.data()) < 1) || (std::stoi(value.data()) > 4096)) {
+				fprintf(stderr, "Invalid fleet file: '%s'\n", tag.data());
+				exit(1);
+			}
+			o.workers = std::stoi(value.data());
+		}
+		else if(tag == "interval") { /* Get the cycle interval. */
+			if(!fleet.empty() || (std::stoi(value.data()) < 0)) {
+				fprintf(stderr, "Invalid fleet file: '%s'\n", tag.data());
+				exit(1);
+			}
+			o.interval = std::stoi(value.data());
+		}
+		else if(tag == "retry") { /* Get the retry rule of an error class. */
+			std::istringstream iss(value);
+			std::string name;
+			long attempts = -1, base = -1, max = -1;
+			iss >> name >> attempts >> base >> max;
+			CGXRetryPolicy::ErrorClass ec = CGXRetryPolicy::GetClass(name.data());
+			if(!fleet.empty() || (ec == CGXRetryPolicy::RETRY_CLASS_COUNT) || (ec == CGXRetryPolicy::RETRY_NONE) ||
+				(attempts < 0) || (attempts > 100) || (base < 0) || (max < base)) {
+				fprintf(stderr, "Invalid fleet file: '%s'\n", tag.data());
+				exit(1);
+			}
+			o.retry.SetRule(ec, attempts, base, max);
+		}
+		else if(tag == "keys") { /* Get the key file. */
+			if(!fleet.empty() || value.empty()) {
+				fprintf(stderr, "Invalid fleet file: '%s'\n", tag.data());
+				exit(1);
+			}
+			o.keys = value;
+		}
+		else if(tag == "connect") { /* Get the connect timeout. */
+			if(!fleet.empty() || (std::stoi(value.data()) < 1)) {
+				fprintf(stderr, "Invalid fleet file: '%s'\n", tag.data());
+				exit(1);
+			}
+			o.connect = std::stoi(value.data());
+		}
+		else if(!prase_tag(tag, value, fleet.empty() ? defaults : fleet.back())) {
+			fprintf(stderr, "Invalid fleet file: '%s'\n", tag.data());
 			exit(1);
 		}
 	}
 
-	/* Check if the elements is empty. */
-	if(p.elements.size() < 1) {
-		fprintf(stderr, "At least 1 element should be specified\n");
+	if(fleet.empty()) {
+		fprintf(stderr, "At least 1 meter should be specified\n");
 		exit(1);
 	}
+	for(std::vector<struct parameter>::iterator iter = fleet.begin(); iter != fleet.end(); iter++) {
+		if(!check_para(*iter, !o.keys.empty())) {
+			fprintf(stderr, "Invalid meter: '%s'\n", iter->name.data());
+			exit(1);
+		}
+	}
 
     return;
 }
 
-
 int main(int argc, char *argv[]) {
 	struct parameter param;
 
-	prase_para(argc, argv, param);
+	/* Daemon mode, the fleet file can be a compiled table. */
+	if((argc == 3) && (strcmp(argv[1], "-D") == 0)) {
+		std::vector<struct parameter> fleet;
+		struct fleet_option o;
 
-	CGXDLMSSecureClient *cl;
-
-    if(param.mode == 1) {
-        if(param.level == DLMS_AUTHENTICATION_LOW) {
-            cl = new CGXDLMSSecureClient(true,
-                                         param.client,
-                                         (1 << 30) | (param.logical << 16),
-                                         param.level,
-                                         param.password.ToString().data(),
-                                         DLMS_INTERFACE_TYPE_HDLC);
-        }
-        else {
-            cl = new CGXDLMSSecureClient(true,
-                                         param.client,
-                                         (1 << 30) | (param.logical << 16),
-                                         param.level,
-                                         nullptr,
-                                         DLMS_INTERFACE_TYPE_HDLC);
-        }
-    }
-    else if (param.mode == 2) {
-        if(param.level == DLMS_AUTHENTICATION_LOW) {
-            cl = new CGXDLMSSecureClient(true,
-                                         param.client,
-                                         (2 << 30) | (param.logical << 16) | (param.physical % 100),
-                                         param.level,
-                                         param.password.ToString().data(),
-                                         DLMS_INTERFACE_TYPE_HDLC);
-        }
-        else {
-            cl = new CGXDLMSSecureClient(true,
-                                         param.client,
-                                         (2 << 30) | (param.logical << 16) | (param.physical % 100),
-                                         param.level,
-                                         nullptr,
-                                         DLMS_INTERFACE_TYPE_HDLC);
-        }
-    }
-    else {
-        if(param.level == DLMS_AUTHENTICATION_LOW) {
-            cl = new CGXDLMSSecureClient(true,
-                                         param.client,
-                                         (3 << 30) | (param.logical << 16) | (param.physical % 10000),
-                                         param.level,
-                                         param.password.ToString().data(),
-                                         DLMS_INTERFACE_TYPE_HDLC);
-        }
-        else {
-            cl = new CGXDLMSSecureClient(true, param.client,
-                                         (3 << 30) | (param.logical << 16) | (param.physical % 10000),
-                                         param.level,
-                                         nullptr,
-                                         DLMS_INTERFACE_TYPE_HDLC);
-        }
-    }
+		int loaded = fleet_load(argv[2], fleet, o);
+		if(loaded < 0) {
+			fprintf(stderr, "Invalid fleet table: '%s'\n", argv[2]);
+			return -1;
+		}
+		if(loaded == 0) {
+			prase_fleet(argv[2], fleet, o);
+		}
+		/* A table is checked like the fleet file it was compiled from. */
+		for(std::vector<struct parameter>::iterator iter = fleet.begin(); (loaded > 0) && (iter != fleet.end()); iter++) {
+			if(!check_para(*iter, !o.keys.empty())) {
+				fprintf(stderr, "Invalid meter in fleet table: '%s'\n", iter->name.data());
+				return -1;
+			}
+		}
+		return fleet_run(fleet, o);
+	}
 
-    if(param.level == DLMS_AUTHENTICATION_HIGH_GMAC) {
-        cl->GetCiphering()->SetSecurity(DLMS_SECURITY_AUTHENTICATION_ENCRYPTION);
-    }
-    else {
-        cl->GetCiphering()->SetSecurity(DLMS_SECURITY_NONE);
-    }
+	/* Put the keys of a meter into a key file, they are wrapped with the key of GATHER_KEK. */
+	if(((argc == 7) || (argc == 8)) && (strcmp(argv[1], "-K") == 0)) {
+		CGXKeyStore::Keys keys;
+		CGXByteBuffer bb;
+		std::string kek;
+		const char *values[4] = { argv[4], argv[5], argv[6], argc == 8 ? argv[7] : "" };
+		std::string *fields[4] = { &keys.systemTitle, &keys.blockCipherKey, &keys.authenticationKey, &keys.password };
+		const size_t sizes[4] = { 16, 32, 32, 0 };
 
-    cl->SetProposedConformance(static_cast<DLMS_CONFORMANCE>(\
-                                   /* DLMS_CONFORMANCE_GENERAL_PROTECTION | \ */
-                                   /* DLMS_CONFORMANCE_GENERAL_BLOCK_TRANSFER | \ */
-                                   /* DLMS_CONFORMANCE_READ | \ */
-                                   /* DLMS_CONFORMANCE_WRITE | \ */
-                                   /* DLMS_CONFORMANCE_UN_CONFIRMED_WRITE | \ */
-                                   /* DLMS_CONFORMANCE_ATTRIBUTE_0_SUPPORTED_WITH_SET | \ */
-                                   /* DLMS_CONFORMANCE_PRIORITY_MGMT_SUPPORTED | \ */
-                                   /* DLMS_CONFORMANCE_ATTRIBUTE_0_SUPPORTED_WITH_GET | \ */
-                                   DLMS_CONFORMANCE_BLOCK_TRANSFER_WITH_GET_OR_READ | \
-                                   DLMS_CONFORMANCE_BLOCK_TRANSFER_WITH_SET_OR_WRITE | \
-                                   DLMS_CONFORMANCE_BLOCK_TRANSFER_WITH_ACTION | \
-                                   DLMS_CONFORMANCE_MULTIPLE_REFERENCES | \
-                                   /* DLMS_CONFORMANCE_INFORMATION_REPORT | \ */
-                                   /* DLMS_CONFORMANCE_DATA_NOTIFICATION | \ */
-                                   DLMS_CONFORMANCE_ACCESS | \
-                                   DLMS_CONFORMANCE_PARAMETERIZED_ACCESS | \
-                                   DLMS_CONFORMANCE_GET | \
-                                   DLMS_CONFORMANCE_SET | \
-                                   DLMS_CONFORMANCE_SELECTIVE_ACCESS | \
-                                   /* DLMS_CONFORMANCE_EVENT_NOTIFICATION | \ */
-                                   DLMS_CONFORMANCE_ACTION\
-                                   ));
-
-    cl->SetAutoIncreaseInvokeID(false);
-	cl->SetServiceClass(DLMS_SERVICE_CLASS_CONFIRMED);
-
-    CGXByteBuffer bb;
-
-	bb.Clear();
-	bb.SetHexString("415A534552564552");
-	cl->GetCiphering()->SetSystemTitle(bb);
-	bb.Clear();
-	bb.SetHexString("31323334353637383132333435363738");
-	cl->GetCiphering()->SetDedicatedKey(bb);
-	cl->GetCiphering()->SetAuthenticationKey(param.akey);
-	cl->GetCiphering()->SetBlockCipherKey(param.ekey);
-
-	CGXCommunication *comm;
-	comm = new CGXCommunication(cl, 6000, GX_TRACE_LEVEL_OFF, nullptr);
-
-	if(comm->Open(param.device.data(), param.negotiate, 115200) != 0) {
-		delete comm;
-		delete cl;
-		fprintf(stderr, "Failed to open device\n");
-		return -1;
+		if(!fleet_kek(kek)) {
+			fprintf(stderr, "GATHER_KEK should be the hex of a key of 16, 24 or 32 bytes\n");
+			return -1;
+		}
+		for(int i = 0; i < 4; i++) {
+			if(((sizes[i] != 0) && (strlen(values[i]) != sizes[i])) || (strlen(values[i]) % 2)) {
+				fprintf(stderr, "Invalid argument: '%s'\n", values[i]);
+				arg_error(argv[0]);
+			}
+			bb.Clear();
+			bb.SetHexString(values[i]);
+			fields[i]->assign(reinterpret_cast<const char *>(bb.GetData()), bb.GetSize());
+		}
+		int ret = CGXKeyStore::Put(argv[2], kek, argv[3], keys);
+		if(ret != 0) {
+			fprintf(stderr, "Failed to put the keys of %s into %s (%d)\n", argv[3], argv[2], ret);
+			return -1;
+		}
+		return 0;
 	}
 
-    if(comm->InitializeConnection() != 0) {
-        comm->Close();
-        delete comm;
-        delete cl;
-		fprintf(stderr, "Failed to initialize the link layer\n");
-        return -1;
-    }
+	/* Compile a fleet file into a table. */
+	if((argc == 4) && (strcmp(argv[1], "-C") == 0)) {
+		std::vector<struct parameter> fleet;
+		struct fleet_option o;
 
-	for(std::vector<struct element>::iterator iter = param.elements.begin(); iter != param.elements.end(); iter++) {
-		CGXDLMSCommon Object(iter->classID, iter->obis.data());
-		std::string result;
+		prase_fleet(argv[2], fleet, o);
+		int ret = fleet_compile(fleet, o, argv[3]);
+		if(ret != 0) {
+			fprintf(stderr, "Failed to write %s (%d)\n", argv[3], ret);
+			return -1;
+		}
+		return 0;
+	}
 
-		if(comm->Read(&Object, iter->index, &iter->selects, result) != DLMS_ERROR_CODE_OK) {
-			fprintf(stdout, "NULL ");
+	/* Query mode. */
+	if(((argc == 6) || (argc == 7)) && (strcmp(argv[1], "-q") == 0)) {
+		std::vector<long long> range;
+		if(argc == 7) {
+			split(argv[6], range, '-');
 		}
-		else {
-			for (const auto& c : result) {
-				fprintf(stdout, "%02X", static_cast<unsigned char>(c));
-			}
-			fprintf(stdout, " ");
+		if((atoi(argv[5]) < 1) || (atoi(argv[5]) > 255) || ((argc == 7) && ((range.size() != 2) || (range[0] > range[1])))) {
+			arg_error(argv[0]);
+		}
+		std::string series = CGXStore::GetSeries(argv[3], argv[4], atoi(argv[5]));
+		int ret = CGXStore::Query(argv[2], series, argc == 7 ? range[0] : 0, argc == 7 ? range[1] : INT64_MAX, stdout);
+		if(ret != 0) {
+			fprintf(stderr, "Failed to query %s (%d)\n", series.data(), ret);
+			return -1;
 		}
+		return 0;
+	}
+
+	prase_para(argc, argv, param);
+	/* Meters of one line share the device, the address keeps their state files apart. */
+	param.name = device_port(param.device) + "#" + std::to_string(param.logical) + "." + std::to_string(param.physical);
+
+	std::string line;
+	struct session_stat st;
+
+	/* Elements which can't be read are NULL, only a failed association fails the run. */
+	session_run(param, line, st);
+	if(st.failures != 0) {
+		return -1;
 	}
-	fprintf(stdout, "\n");
+	line.append("\n");
+	fwrite(line.data(), 1, line.size(), stdout);
 
-	comm->Close();
-	delete comm;
-	delete cl;
     return 0;
 }
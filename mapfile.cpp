@@ -0,0 +1,111 @@
+#include <errno.h>
+#include "mapfile.h"
+
+#if defined(_WIN32) || defined(_WIN64)//Windows includes
+#include <windows.h>
+#else //Linux includes.
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+CGXMappedFile::CGXMappedFile() : m_Data(NULL), m_Size(0)
+{
+#if defined(_WIN32) || defined(_WIN64)//Windows
+    m_File = INVALID_HANDLE_VALUE;
+    m_Mapping = NULL;
+#endif
+}
+
+CGXMappedFile::~CGXMappedFile()
+{
+    Close();
+}
+
+int CGXMappedFile::Open(const std::string& path)
+{
+    Close();
+#if defined(_WIN32) || defined(_WIN64)//Windows
+    m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_File == INVALID_HANDLE_VALUE)
+    {
+        return GetLastError() == ERROR_FILE_NOT_FOUND ? ENOENT : (int)GetLastError();
+    }
+    LARGE_INTEGER length;
+    if (!GetFileSizeEx(m_File, &length))
+    {
+        return (int)GetLastError();
+    }
+    if (length.QuadPart == 0)
+    {
+        return 0;
+    }
+    m_Mapping = CreateFileMappingA(m_File, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_Mapping == NULL)
+    {
+        return (int)GetLastError();
+    }
+    m_Data = (const unsigned char*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+    if (m_Data == NULL)
+    {
+        return (int)GetLastError();
+    }
+    m_Size = (unsigned long)length.QuadPart;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        return errno;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        int ret = errno;
+        close(fd);
+        return ret;
+    }
+    if (st.st_size != 0)
+    {
+        void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            int ret = errno;
+            close(fd);
+            return ret;
+        }
+        m_Data = (const unsigned char*)p;
+        m_Size = (unsigned long)st.st_size;
+    }
+    close(fd);
+#endif
+    return 0;
+}
+
+void CGXMappedFile::Close()
+{
+#if defined(_WIN32) || defined(_WIN64)//Windows
+    if (m_Data != NULL)
+    {
+        UnmapViewOfFile(m_Data);
+    }
+    if (m_Mapping != NULL)
+    {
+        CloseHandle(m_Mapping);
+        m_Mapping = NULL;
+    }
+    if (m_File != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_File);
+        m_File = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (m_Data != NULL)
+    {
+        munmap((void*)m_Data, m_Size);
+    }
+#endif
+    m_Data = NULL;
+    m_Size = 0;
+}
@@ -0,0 +1,36 @@
+#ifndef GXMAPFILE_H
+#define GXMAPFILE_H
+
+#include <string>
+
+//Read only mapping of a whole file. The pages are shared with every other
+//process which maps the same file.
+class CGXMappedFile
+{
+#if defined(_WIN32) || defined(_WIN64)//Windows
+    void* m_File;
+    void* m_Mapping;
+#endif
+    const unsigned char* m_Data;
+    unsigned long m_Size;
+public:
+    CGXMappedFile();
+    ~CGXMappedFile();
+
+    //Map a file, an empty file has no data. Returns 0 or the system error.
+    int Open(const std::string& path);
+
+    void Close();
+
+    const unsigned char* GetData() const
+    {
+        return m_Data;
+    }
+
+    unsigned long GetSize() const
+    {
+        return m_Size;
+    }
+};
+
+#endif //GXMAPFILE_H
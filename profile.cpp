@@ -0,0 +1,302 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "gather.h"
+#include "axdr.h"
+#include "decoder.h"
+
+/* Rows up to this much ahead of the local clock are read, the clock of a meter may be ahead. */
+#define PROFILE_AHEAD 86400
+
+/* Offsets of the values which are patched into the compiled selectors. */
+#define PROFILE_ENTRY_FROM 4
+#define PROFILE_ENTRY_TO 9
+#define PROFILE_RANGE_FROM 23
+#define PROFILE_RANGE_TO 37
+
+/* Civil date of days since 1970-01-01. */
+static void profile_civil(long long z, long long& y, unsigned int& m, unsigned int& d) {
+	z += 719468;
+	long long era = (z >= 0 ? z : z - 146096) / 146097;
+	unsigned int doe = (unsigned int)(z - era * 146097);
+	unsigned int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	unsigned int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	unsigned int mp = (5 * doy + 2) / 153;
+	d = doy - (153 * mp + 2) / 5 + 1;
+	m = mp < 10 ? mp + 3 : mp - 9;
+	y = (long long)yoe + era * 400 + (m <= 2);
+}
+
+/* Put a time into the 12 bytes of a date-time, the deviation is not specified. */
+static void profile_time(std::string& value, size_t pos, long long t) {
+	long long days = t / 86400, y;
+	unsigned int m, d;
+
+	if(t % 86400 < 0) {
+		days --;
+	}
+	long long seconds = t - days * 86400;
+	profile_civil(days, y, m, d);
+	value[pos] = (char)(y >> 8);
+	value[pos + 1] = (char)y;
+	value[pos + 2] = (char)m;
+	value[pos + 3] = (char)d;
+	value[pos + 4] = (char)0xff;
+	value[pos + 5] = (char)(seconds / 3600);
+	value[pos + 6] = (char)(seconds / 60 % 60);
+	value[pos + 7] = (char)(seconds % 60);
+	value[pos + 8] = 0;
+	value[pos + 9] = (char)0x80;
+	value[pos + 10] = 0;
+	value[pos + 11] = 0;
+}
+
+/* Put a number into big endian bytes. */
+static void profile_number(std::string& value, size_t pos, uint32_t number) {
+	value[pos] = (char)(number >> 24);
+	value[pos + 1] = (char)(number >> 16);
+	value[pos + 2] = (char)(number >> 8);
+	value[pos + 3] = (char)number;
+}
+
+void profile_compile(struct element& e, uint8_t select, const std::string& selected) {
+	CGXByteBuffer value;
+
+	if(select == PROFILE_BY_ENTRY) {
+		value.SetUInt8(2);//by entry
+		value.SetUInt8(DLMS_DATA_TYPE_STRUCTURE);
+		value.SetUInt8(4);
+		//from entry
+		value.SetUInt8(DLMS_DATA_TYPE_UINT32);
+		value.SetUInt32(0);
+		//to entry
+		value.SetUInt8(DLMS_DATA_TYPE_UINT32);
+		value.SetUInt32(0);
+		//from selected value
+		value.SetUInt8(DLMS_DATA_TYPE_UINT16);
+		value.SetUInt16(e.columns.empty() ? 0 : e.columns.front());
+		//to selected value
+		value.SetUInt8(DLMS_DATA_TYPE_UINT16);
+		value.SetUInt16(e.columns.empty() ? 0 : e.columns.back());
+		e.plan.entry.assign(reinterpret_cast<const char *>(value.GetData()), value.GetSize());
+		return;
+	}
+
+	value.SetUInt8(1);//by range
+	value.SetUInt8(DLMS_DATA_TYPE_STRUCTURE);
+	value.SetUInt8(4);
+	//restricting object
+	value.SetUInt8(DLMS_DATA_TYPE_STRUCTURE);
+	value.SetUInt8(4);
+	value.SetUInt8(DLMS_DATA_TYPE_UINT16);
+	value.SetUInt16(8);
+	value.SetUInt8(DLMS_DATA_TYPE_OCTET_STRING);
+	value.SetUInt8(6);
+	value.SetHexString("0000010000FF");
+	value.SetUInt8(DLMS_DATA_TYPE_INT8);
+	value.SetUInt8(2);
+	value.SetUInt8(DLMS_DATA_TYPE_UINT16);
+	value.SetUInt16(0);
+	//from and to, the times are patched for each read
+	for(int i = 0; i < 2; i++) {
+		value.SetUInt8(DLMS_DATA_TYPE_OCTET_STRING);
+		value.SetUInt8(12);
+		for(int j = 0; j < 12; j++) {
+			value.SetUInt8(0);
+		}
+	}
+	//selected values
+	if(selected.empty()) {
+		value.SetUInt8(DLMS_DATA_TYPE_ARRAY);
+		value.SetUInt8(0);
+	}
+	else {
+		value.Set(selected.data(), selected.size());
+	}
+	e.plan.range.assign(reinterpret_cast<const char *>(value.GetData()), value.GetSize());
+}
+
+void profile_entry(struct element& e, CGXByteBuffer& value, uint32_t from, uint32_t to) {
+	profile_number(e.plan.entry, PROFILE_ENTRY_FROM, from);
+	profile_number(e.plan.entry, PROFILE_ENTRY_TO, to);
+	value.Clear();
+	value.Set(e.plan.entry.data(), e.plan.entry.size());
+}
+
+void profile_range(struct element& e, CGXByteBuffer& value, long long from, long long to) {
+	profile_time(e.plan.range, PROFILE_RANGE_FROM, from);
+	profile_time(e.plan.range, PROFILE_RANGE_TO, to);
+	value.Clear();
+	value.Set(e.plan.range.data(), e.plan.range.size());
+}
+
+bool profile_row(const unsigned char *data, unsigned long size, const std::vector<uint16_t>& columns, std::string& row) {
+	unsigned long pos = 0, count, start;
+
+	if((size == 0) || (data[pos ++] != DLMS_DATA_TYPE_STRUCTURE) || !CGXAxdr::GetLength(data, size, pos, count)) {
+		return false;
+	}
+	row.push_back((char)DLMS_DATA_TYPE_STRUCTURE);
+	/* Columns past the last one of the row are not there. */
+	size_t kept = 0;
+	for(size_t c = 0; c < columns.size(); c++) {
+		if(columns[c] - columns[0] < (long)count) {
+			kept ++;
+		}
+	}
+	CGXAxdr::SetLength(kept, row);
+	size_t next = 0;
+	for(unsigned long c = 0; c < count; c++) {
+		start = pos;
+		if(!CGXAxdr::Skip(data, size, pos)) {
+			return false;
+		}
+		if((next < columns.size()) && (columns[next] - columns[0] == (long)c)) {
+			row.append(reinterpret_cast<const char *>(data) + start, pos - start);
+			next ++;
+		}
+	}
+	return true;
+}
+
+std::string profile_key(const struct element& e) {
+	char index[8];
+
+	snprintf(index, sizeof(index), "%u", (unsigned int)e.index);
+	return std::string(e.select == PROFILE_BY_RANGE ? "mark.time." : "mark.entry.") + e.obis + "." + index;
+}
+
+bool profile_bounds(const std::map<std::string, std::string>& state, const struct element& e, long long& from, long long& to) {
+	if(!e.mark) {
+		from = e.from;
+		to = e.to;
+		return e.select != 0;
+	}
+
+	std::map<std::string, std::string>::const_iterator it = state.find(profile_key(e));
+	long long mark = it == state.end() ? 0 : strtoll(it->second.data(), NULL, 10);
+	if(mark < 0) {
+		mark = 0;
+	}
+	/* The first read gets the whole buffer, the marks by entry are taken by profile_resync. */
+	if(mark == 0) {
+		return false;
+	}
+	from = mark + 1;
+	to = (long long)time(NULL) + PROFILE_AHEAD;
+	return true;
+}
+
+/* Get the capture time of a row, the first column of the row. Returns false if it is not a date-time. */
+static bool profile_captured(const unsigned char *data, unsigned long size, unsigned long pos, long long& t) {
+	/* The row is a structure, the first column a date-time or an octet string of 12 bytes. */
+	if((size - pos < 3) || (data[pos] != DLMS_DATA_TYPE_STRUCTURE) || (data[pos + 1] == 0)) {
+		return false;
+	}
+	pos += 2;
+	if((size - pos >= 14) && (data[pos] == DLMS_DATA_TYPE_OCTET_STRING) && (data[pos + 1] == 12)) {
+		pos += 2;
+	}
+	else if((size - pos >= 13) && (data[pos] == DLMS_DATA_TYPE_DATETIME)) {
+		pos += 1;
+	}
+	else {
+		return false;
+	}
+	return CGXProfileDecoder::GetTime(data + pos, t);
+}
+
+int profile_resync(const std::map<std::string, std::string>& state, const struct element& e, long long entries, long long size, long long& from, long long& to) {
+	std::map<std::string, std::string>::const_iterator it = state.find(profile_key(e));
+	long long mark = it == state.end() ? 0 : strtoll(it->second.data(), NULL, 10);
+	if(mark < 0) {
+		mark = 0;
+	}
+
+	/* Until the buffer is full the entries keep their numbers, a buffer which was cleared is read again from its start. */
+	if(entries < size) {
+		if(mark == entries) {
+			return 0;
+		}
+		from = mark < entries ? mark + 1 : 1;
+		to = 0;
+		return PROFILE_BY_ENTRY;
+	}
+	/* A full buffer moves the numbers with each capture, the rows after the last one read are found by their capture time. */
+	it = state.find(profile_key(e) + ".time");
+	if(it == state.end()) {
+		/* Without a capture time only the first read, of the whole buffer, is exact. */
+		if(mark != 0) {
+			return -1;
+		}
+		from = 1;
+		to = 0;
+		return PROFILE_BY_ENTRY;
+	}
+	from = strtoll(it->second.data(), NULL, 10) + 1;
+	to = (long long)time(NULL) + PROFILE_AHEAD;
+	return PROFILE_BY_RANGE;
+}
+
+bool profile_last(const struct element& e, const std::string& result, long long base, long long& last) {
+	const unsigned char *data = reinterpret_cast<const unsigned char *>(result.data());
+	std::vector<unsigned long> rows;
+
+	if(!CGXAxdr::GetRows(data, result.size(), rows) || rows.empty()) {
+		return false;
+	}
+	if(e.select == PROFILE_BY_RANGE) {
+		return profile_captured(data, result.size(), rows.back(), last);
+	}
+	last = base + (long long)rows.size();
+	return true;
+}
+
+bool profile_advance(const struct element& e, const std::string& result, long long base, std::map<std::string, std::string>& marks) {
+	const unsigned char *data = reinterpret_cast<const unsigned char *>(result.data());
+	std::vector<unsigned long> rows;
+	char value[24];
+	long long t, last;
+
+	if(!CGXAxdr::GetRows(data, result.size(), rows)) {
+		fprintf(stderr, "Profile %s is not an array, the mark is kept\n", e.obis.data());
+		return false;
+	}
+	if(rows.empty()) {
+		return false;
+	}
+	if(!profile_last(e, result, base, last)) {
+		fprintf(stderr, "Profile %s has no capture time, the mark is kept\n", e.obis.data());
+		return false;
+	}
+	/* The capture time finds the next rows by entry when the buffer is full. */
+	if((e.select == PROFILE_BY_ENTRY) && profile_captured(data, result.size(), rows.back(), t)) {
+		snprintf(value, sizeof(value), "%lld", t);
+		marks[profile_key(e) + ".time"] = value;
+	}
+	snprintf(value, sizeof(value), "%lld", last);
+	marks[profile_key(e)] = value;
+	return true;
+}
+
+void profile_gaps(std::vector<long long>& times, long long period, long long from, std::vector<std::pair<long long, long long>>& gaps) {
+	gaps.clear();
+	std::sort(times.begin(), times.end());
+	times.erase(std::unique(times.begin(), times.end()), times.end());
+	if(times.empty() || (period <= 0)) {
+		return;
+	}
+	/* A gap is where a row of at least one capture period is missing, rows after the last one are read as usual. */
+	if(times.front() - from >= period) {
+		gaps.push_back(std::make_pair(from, times.front() - 1));
+	}
+	for(size_t i = 1; i < times.size(); i++) {
+		if(times[i] - times[i - 1] > period) {
+			gaps.push_back(std::make_pair(times[i - 1] + 1, times[i] - 1));
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#include <string.h>
+#include <random>
+#include "retry.h"
+#include "dlms/include/errorcodes.h"
+
+CGXRetryPolicy::CGXRetryPolicy()
+{
+    SetRule(RETRY_NONE, 0, 0, 0);
+    //Busy meters are usually ready again in a second.
+    SetRule(RETRY_REJECTED, 3, 1000, 8000);
+    SetRule(RETRY_TIMEOUT, 2, 5000, 60000);
+    SetRule(RETRY_CONNECT, 2, 10000, 120000);
+}
+
+void CGXRetryPolicy::SetRule(ErrorClass errorClass, int attempts, long base, long max)
+{
+    m_Rules[errorClass].attempts = attempts;
+    m_Rules[errorClass].base = base;
+    m_Rules[errorClass].max = max < base ? base : max;
+}
+
+long CGXRetryPolicy::GetDelay(ErrorClass errorClass, int attempt) const
+{
+    const Rule& rule = m_Rules[errorClass];
+    if (attempt < 1 || attempt > rule.attempts)
+    {
+        return -1;
+    }
+    long delay = rule.base;
+    for (int i = 1; i != attempt && delay < rule.max; ++i)
+    {
+        delay *= 2;
+    }
+    if (delay > rule.max)
+    {
+        delay = rule.max;
+    }
+    if (delay <= 1)
+    {
+        return delay;
+    }
+    //Wait between the half and the whole delay.
+    static thread_local std::mt19937 random(std::random_device{}());
+    std::uniform_int_distribution<long> jitter(delay / 2, delay);
+    return jitter(random);
+}
+
+CGXRetryPolicy::ErrorClass CGXRetryPolicy::Classify(int error)
+{
+    switch (error)
+    {
+    case DLMS_ERROR_CODE_REJECTED:
+    case DLMS_ERROR_CODE_TEMPORARY_FAILURE:
+        return RETRY_REJECTED;
+    case DLMS_ERROR_CODE_SEND_FAILED:
+    case DLMS_ERROR_CODE_RECEIVE_FAILED:
+        return RETRY_TIMEOUT;
+    default:
+        return RETRY_NONE;
+    }
+}
+
+CGXRetryPolicy::ErrorClass CGXRetryPolicy::GetClass(const char* name)
+{
+    static const char* NAMES[RETRY_CLASS_COUNT] = { "none", "rejected", "timeout", "connect" };
+    for (int i = 0; i != RETRY_CLASS_COUNT; ++i)
+    {
+        if (strcmp(name, NAMES[i]) == 0)
+        {
+            return (ErrorClass)i;
+        }
+    }
+    return RETRY_CLASS_COUNT;
+}
@@ -0,0 +1,57 @@
+#ifndef GXRETRY_H
+#define GXRETRY_H
+
+//When and how often a failed exchange is tried again.
+//Errors are put into classes, each class has a bounded number of attempts
+//and an exponential backoff. The delay is jittered, so meters which failed
+//together don't come back together.
+class CGXRetryPolicy
+{
+public:
+    enum ErrorClass
+    {
+        //Error which doesn't go away by trying again, like a denied access.
+        RETRY_NONE,
+        //Meter is busy and rejected the request.
+        RETRY_REJECTED,
+        //Meter didn't answer or the link broke.
+        RETRY_TIMEOUT,
+        //Device couldn't be opened or connected.
+        RETRY_CONNECT,
+        RETRY_CLASS_COUNT
+    };
+
+    struct Rule
+    {
+        //Number of attempts after the first one.
+        int attempts;
+        //Delay before the first attempt and the longest delay in milliseconds.
+        long base;
+        long max;
+    };
+
+private:
+    Rule m_Rules[RETRY_CLASS_COUNT];
+
+public:
+    CGXRetryPolicy();
+
+    void SetRule(ErrorClass errorClass, int attempts, long base, long max);
+
+    const Rule& GetRule(ErrorClass errorClass) const
+    {
+        return m_Rules[errorClass];
+    }
+
+    //Get the delay in milliseconds before an attempt, attempt is 1 for the first one after the failure.
+    //Returns -1 if there are no attempts left.
+    long GetDelay(ErrorClass errorClass, int attempt) const;
+
+    //Get the class of a DLMS error code.
+    static ErrorClass Classify(int error);
+
+    //Get the class by its name, like "rejected". Returns RETRY_CLASS_COUNT if the name is unknown.
+    static ErrorClass GetClass(const char* name);
+};
+
+#endif //GXRETRY_H
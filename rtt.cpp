@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "rtt.h"
+
+//Clock granularity, also covers the scheduling jitter of serial drivers.
+#define GX_RTT_GRANULARITY 50
+//Most timeouts which double the wait time.
+#define GX_RTT_MAX_BACKOFF 6
+
+CGXRttEstimator::CGXRttEstimator() : m_Srtt(0), m_RttVar(0), m_Backoff(0)
+{
+}
+
+void CGXRttEstimator::Sample(long rtt)
+{
+    if (rtt <= 0)
+    {
+        rtt = 1;
+    }
+    if (m_Srtt == 0)
+    {
+        m_Srtt = rtt;
+        m_RttVar = rtt / 2;
+    }
+    else
+    {
+        long delta = m_Srtt > rtt ? m_Srtt - rtt : rtt - m_Srtt;
+        m_RttVar = (3 * m_RttVar + delta) / 4;
+        m_Srtt = (7 * m_Srtt + rtt) / 8;
+        if (m_Srtt == 0)
+        {
+            m_Srtt = 1;
+        }
+    }
+    m_Backoff = 0;
+}
+
+void CGXRttEstimator::Timeout()
+{
+    if (m_Backoff < GX_RTT_MAX_BACKOFF)
+    {
+        ++m_Backoff;
+    }
+}
+
+long CGXRttEstimator::GetTimeout(long min, long max) const
+{
+    if (m_Srtt == 0)
+    {
+        return max;
+    }
+    long timeout = m_Srtt + (4 * m_RttVar > GX_RTT_GRANULARITY ? 4 * m_RttVar : GX_RTT_GRANULARITY);
+    if (timeout < min)
+    {
+        timeout = min;
+    }
+    for (int i = 0; i != m_Backoff && timeout < max; ++i)
+    {
+        timeout *= 2;
+    }
+    return timeout > max ? max : timeout;
+}
+
+std::string CGXRttEstimator::ToString() const
+{
+    char tmp[32];
+    snprintf(tmp, sizeof(tmp), "%ld,%ld", m_Srtt, m_RttVar);
+    return tmp;
+}
+
+bool CGXRttEstimator::FromString(const std::string& value)
+{
+    long srtt, rttvar;
+    if (sscanf(value.c_str(), "%ld,%ld", &srtt, &rttvar) != 2 || srtt <= 0 || rttvar < 0)
+    {
+        return false;
+    }
+    m_Srtt = srtt;
+    m_RttVar = rttvar;
+    m_Backoff = 0;
+    return true;
+}
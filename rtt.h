@@ -0,0 +1,42 @@
+#ifndef GXRTT_H
+#define GXRTT_H
+
+#include <string>
+
+//Estimates the round trip time of a meter like TCP does (RFC 6298).
+//The time to wait for a reply is the smoothed round trip time plus four
+//times its variance, so a fast meter gets a tight bound and a slow or
+//jittery one a loose bound. Timeouts double the bound until a reply arrives.
+class CGXRttEstimator
+{
+    //Smoothed round trip time and its variance in milliseconds.
+    long m_Srtt;
+    long m_RttVar;
+    //Number of timeouts since the last reply.
+    int m_Backoff;
+public:
+    CGXRttEstimator();
+
+    //Is there a sample.
+    bool IsKnown() const
+    {
+        return m_Srtt != 0;
+    }
+
+    //Add the round trip time of a request which was sent once.
+    void Sample(long rtt);
+
+    //Reply was not received in time.
+    void Timeout();
+
+    //Get the time to wait for a reply. Without samples it is max.
+    long GetTimeout(long min, long max) const;
+
+    //Get the estimate as "srtt,rttvar" for the state file.
+    std::string ToString() const;
+
+    //Set the estimate from the state file. Returns false if the value is not valid.
+    bool FromString(const std::string& value);
+};
+
+#endif //GXRTT_H
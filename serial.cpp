@@ -0,0 +1,46 @@
+#if !defined(_WIN32) && !defined(_WIN64)//If Linux
+#include <sys/ioctl.h>
+#include <asm/termbits.h>
+#include <linux/serial.h>
+#include "serial.h"
+
+int GXSetCustomBaudRate(int fd, unsigned long baudRate)
+{
+    struct termios2 options;
+    if (ioctl(fd, TCGETS2, &options) != 0)
+    {
+        return -1;
+    }
+    options.c_cflag &= ~CBAUD;
+    options.c_cflag |= BOTHER;
+    options.c_ispeed = baudRate;
+    options.c_ospeed = baudRate;
+    if (ioctl(fd, TCSETS2, &options) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int GXSetLowLatency(int fd, bool enable)
+{
+    struct serial_struct serial;
+    if (ioctl(fd, TIOCGSERIAL, &serial) != 0)
+    {
+        return -1;
+    }
+    if (enable)
+    {
+        serial.flags |= ASYNC_LOW_LATENCY;
+    }
+    else
+    {
+        serial.flags &= ~ASYNC_LOW_LATENCY;
+    }
+    if (ioctl(fd, TIOCSSERIAL, &serial) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+#endif
@@ -0,0 +1,15 @@
+#ifndef GXSERIAL_H
+#define GXSERIAL_H
+
+#if !defined(_WIN32) && !defined(_WIN64)//If Linux
+//These live in their own file because <asm/termbits.h> clashes with <termios.h>.
+
+//Set a baud rate which has no Bxxx constant, using termios2 and BOTHER.
+int GXSetCustomBaudRate(int fd, unsigned long baudRate);
+
+//Turn ASYNC_LOW_LATENCY of the serial driver on or off.
+//USB adapters then forward received bytes at once instead of every few milliseconds.
+int GXSetLowLatency(int fd, bool enable);
+#endif
+
+#endif //GXSERIAL_H
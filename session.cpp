@@ -0,0 +1,844 @@
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <random>
+#include "gather.h"
+#include "communication.h"
+#include "connector.h"
+#include "state.h"
+#include "axdr.h"
+#include "decoder.h"
+#include "hex.h"
+#include "store.h"
+#include "dlms/include/GXDLMSCommon.h"
+
+/* How many times a lost link is set up again in a session. */
+#define SESSION_RECOVER 3
+
+/* Create the client of a session, the keys of the key store are taken before the keys of the parameters. */
+static CGXDLMSSecureClient *session_client(struct parameter& p, const CGXKeyStore::Keys *keys) {
+	CGXDLMSSecureClient *cl;
+	int server;
+
+	/* The wrapper addresses the logical device directly. */
+	if(p.interfaceType == DLMS_INTERFACE_TYPE_WRAPPER) {
+		server = p.logical;
+	}
+	else if(p.mode == 1) {
+		server = (1 << 30) | (p.logical << 16);
+	}
+	else if(p.mode == 2) {
+		server = (2 << 30) | (p.logical << 16) | (p.physical % 100);
+	}
+	else {
+		server = (3 << 30) | (p.logical << 16) | (p.physical % 10000);
+	}
+
+    if(p.level == DLMS_AUTHENTICATION_LOW) {
+        cl = new CGXDLMSSecureClient(true,
+                                     p.client,
+                                     server,
+                                     p.level,
+                                     (keys != nullptr) && !keys->password.empty() ?
+                                         keys->password.data() : p.password.ToString().data(),
+                                     p.interfaceType);
+    }
+    else {
+        cl = new CGXDLMSSecureClient(true,
+                                     p.client,
+                                     server,
+                                     p.level,
+                                     nullptr,
+                                     p.interfaceType);
+    }
+
+    if(p.level == DLMS_AUTHENTICATION_HIGH_GMAC) {
+        cl->GetCiphering()->SetSecurity(DLMS_SECURITY_AUTHENTICATION_ENCRYPTION);
+    }
+    else {
+        cl->GetCiphering()->SetSecurity(DLMS_SECURITY_NONE);
+    }
+
+    cl->SetProposedConformance(static_cast<DLMS_CONFORMANCE>(\
+                                   /* DLMS_CONFORMANCE_GENERAL_PROTECTION | \ */
+                                   /* DLMS_CONFORMANCE_GENERAL_BLOCK_TRANSFER | \ */
+                                   /* DLMS_CONFORMANCE_READ | \ */
+                                   /* DLMS_CONFORMANCE_WRITE | \ */
+                                   /* DLMS_CONFORMANCE_UN_CONFIRMED_WRITE | \ */
+                                   /* DLMS_CONFORMANCE_ATTRIBUTE_0_SUPPORTED_WITH_SET | \ */
+                                   /* DLMS_CONFORMANCE_PRIORITY_MGMT_SUPPORTED | \ */
+                                   /* DLMS_CONFORMANCE_ATTRIBUTE_0_SUPPORTED_WITH_GET | \ */
+                                   DLMS_CONFORMANCE_BLOCK_TRANSFER_WITH_GET_OR_READ | \
+                                   DLMS_CONFORMANCE_BLOCK_TRANSFER_WITH_SET_OR_WRITE | \
+                                   DLMS_CONFORMANCE_BLOCK_TRANSFER_WITH_ACTION | \
+                                   DLMS_CONFORMANCE_MULTIPLE_REFERENCES | \
+                                   /* DLMS_CONFORMANCE_INFORMATION_REPORT | \ */
+                                   /* DLMS_CONFORMANCE_DATA_NOTIFICATION | \ */
+                                   DLMS_CONFORMANCE_ACCESS | \
+                                   DLMS_CONFORMANCE_PARAMETERIZED_ACCESS | \
+                                   DLMS_CONFORMANCE_GET | \
+                                   DLMS_CONFORMANCE_SET | \
+                                   DLMS_CONFORMANCE_SELECTIVE_ACCESS | \
+                                   /* DLMS_CONFORMANCE_EVENT_NOTIFICATION | \ */
+                                   DLMS_CONFORMANCE_ACTION\
+                                   ));
+
+	/* Proposed in SNRM, the meter answers with the values it accepts. */
+	if(p.interfaceType == DLMS_INTERFACE_TYPE_HDLC) {
+		cl->GetHdlcSettings().SetMaxInfoRX(p.info);
+		cl->GetHdlcSettings().SetMaxInfoTX(p.info);
+		cl->GetHdlcSettings().SetWindowSizeRX(p.frames);
+		cl->GetHdlcSettings().SetWindowSizeTX(p.frames);
+	}
+
+	/* The meter streams blocks in windows, if it grants general block transfer. */
+	if(p.window != 0) {
+		cl->SetProposedConformance(static_cast<DLMS_CONFORMANCE>(cl->GetProposedConformance() | DLMS_CONFORMANCE_GENERAL_BLOCK_TRANSFER));
+		cl->SetGbtWindowSize(p.window);
+	}
+
+    cl->SetAutoIncreaseInvokeID(false);
+	cl->SetServiceClass(DLMS_SERVICE_CLASS_CONFIRMED);
+
+    CGXByteBuffer bb;
+
+	if(keys != nullptr) {
+		bb.Set(keys->systemTitle.data(), keys->systemTitle.size());
+	}
+	else if(p.title.GetSize() != 0) {
+		bb.Set(&p.title);
+	}
+	else {
+		bb.SetHexString("415A534552564552");
+	}
+	cl->GetCiphering()->SetSystemTitle(bb);
+	/* The dedicated key is new for each association, it is taken from the random source of the system. */
+	std::random_device random;
+	bb.Clear();
+	for(int i = 0; i < 16; i++) {
+		bb.SetUInt8((unsigned char)random());
+	}
+	cl->GetCiphering()->SetDedicatedKey(bb);
+	if(keys != nullptr) {
+		bb.Clear();
+		bb.Set(keys->authenticationKey.data(), keys->authenticationKey.size());
+		cl->GetCiphering()->SetAuthenticationKey(bb);
+		bb.Clear();
+		bb.Set(keys->blockCipherKey.data(), keys->blockCipherKey.size());
+		cl->GetCiphering()->SetBlockCipherKey(bb);
+	}
+	else {
+		cl->GetCiphering()->SetAuthenticationKey(p.akey);
+		cl->GetCiphering()->SetBlockCipherKey(p.ekey);
+	}
+
+	return cl;
+}
+
+std::string device_port(const std::string& device) {
+	/* Every TCP/IP endpoint is a line of its own. */
+	if(device.compare(0, 6, "tcp://") == 0) {
+		return device;
+	}
+	return device.substr(0, device.find(':'));
+}
+
+bool device_tcp(const std::string& device, std::string& host, unsigned short& port) {
+	std::string address;
+	size_t pos;
+
+	if(device.compare(0, 6, "tcp://") != 0) {
+		return false;
+	}
+	address = device.substr(6);
+	port = 4059;
+
+	/* IPv6 address is written in brackets, like tcp://[fe80::1]:4059. */
+	if(!address.empty() && (address[0] == '[')) {
+		pos = address.find(']');
+		if(pos == std::string::npos) {
+			return false;
+		}
+		host = address.substr(1, pos - 1);
+		address.erase(0, pos + 1);
+		if(!address.empty() && (address[0] != ':')) {
+			return false;
+		}
+		pos = address.empty() ? std::string::npos : 0;
+	}
+	else {
+		pos = address.find(':');
+		host = address.substr(0, pos);
+	}
+	if(host.empty()) {
+		return false;
+	}
+
+	if(pos != std::string::npos) {
+		std::string number = address.substr(pos + 1);
+		if(number.empty() || (number.size() > 5) || (number.find_first_not_of("0123456789") != std::string::npos)) {
+			return false;
+		}
+		if((std::stoi(number) < 1) || (std::stoi(number) > 65535)) {
+			return false;
+		}
+		port = std::stoi(number);
+	}
+
+	return true;
+}
+
+/* Error of a request which means the link is lost. */
+static bool session_lost(int ret) {
+	return CGXRetryPolicy::Classify(ret) == CGXRetryPolicy::RETRY_TIMEOUT;
+}
+
+/* Set up the link again, at most SESSION_RECOVER times in a session.
+ * When it can't be set up, recovers is past SESSION_RECOVER and the link is given up. */
+static int session_recover(CGXCommunication *comm, int& recovers) {
+	int ret;
+
+	if(recovers >= SESSION_RECOVER) {
+		recovers = SESSION_RECOVER + 1;
+		return -1;
+	}
+	recovers ++;
+	fprintf(stderr, "Link lost, connecting again (%d/%d)\n", recovers, SESSION_RECOVER);
+	if((ret = comm->Reconnect()) != 0) {
+		fprintf(stderr, "Failed to connect again (%d)\n", ret);
+		recovers = SESSION_RECOVER + 1;
+	}
+	return ret;
+}
+
+/* Read an element, the read is done again on a new association if the link is lost. */
+static int session_read(CGXCommunication *comm, struct element& e, CGXByteBuffer& selects, std::string& value, int& recovers) {
+	int ret;
+
+	/* The link is given up. */
+	if(recovers > SESSION_RECOVER) {
+		return DLMS_ERROR_CODE_RECEIVE_FAILED;
+	}
+	for(;;) {
+		CGXDLMSCommon Object(e.classID, e.obis.data());
+		ret = comm->Read(&Object, e.index, &selects, value);
+		if(!session_lost(ret) || (session_recover(comm, recovers) != 0)) {
+			return ret;
+		}
+	}
+}
+
+/* Get the capture objects of the columns of a profile out of the array of all its capture objects. */
+static bool session_select(const std::string& objects, const std::vector<uint16_t>& columns, std::string& selected) {
+	const unsigned char *data = reinterpret_cast<const unsigned char *>(objects.data());
+	std::vector<unsigned long> offsets;
+
+	if(!CGXAxdr::GetRows(data, objects.size(), offsets) || (offsets.size() < columns.back())) {
+		return false;
+	}
+	offsets.push_back(objects.size());
+	selected.assign(1, (char)DLMS_DATA_TYPE_ARRAY);
+	CGXAxdr::SetLength(columns.size(), selected);
+	for(std::vector<uint16_t>::const_iterator iter = columns.begin(); iter != columns.end(); iter++) {
+		selected.append(objects, offsets[*iter - 1], offsets[*iter] - offsets[*iter - 1]);
+	}
+	return true;
+}
+
+/* Get the capture objects of the columns of a profile, as the selected values of a read by range. */
+static int session_columns(CGXCommunication *comm, struct element& e, std::string& selected, int& recovers) {
+	struct element capture = e;
+	CGXByteBuffer none;
+	std::string objects;
+	int ret;
+
+	/* Attribute 3 of a profile is the array of its capture objects. */
+	capture.index = 3;
+	if((ret = session_read(comm, capture, none, objects, recovers)) != DLMS_ERROR_CODE_OK) {
+		return ret;
+	}
+	if(!session_select(objects, e.columns, selected)) {
+		fprintf(stderr, "Profile %s has no column %u\n", e.obis.data(), (unsigned int)e.columns.back());
+		return DLMS_ERROR_CODE_INVALID_PARAMETER;
+	}
+	return DLMS_ERROR_CODE_OK;
+}
+
+/* Collects the rows of a profile as they arrive, only the wanted columns are kept. */
+struct session_rows : public CGXRowSink {
+	std::string rows;
+	unsigned long count = 0;
+	/* Columns to keep, empty keeps the rows as they are. */
+	const std::vector<uint16_t> *columns = nullptr;
+
+	int OnRow(const unsigned char *data, unsigned long size) {
+		if((columns == nullptr) || columns->empty()) {
+			rows.append(reinterpret_cast<const char *>(data), size);
+		}
+		else if(!profile_row(data, size, *columns, rows)) {
+			return DLMS_ERROR_CODE_INVALID_RESPONSE;
+		}
+		count ++;
+		return 0;
+	}
+};
+
+/* Read the rows of a profile into a sink, the read is done again on a new association if the link is lost.
+ * The rows of a read which fails are dropped, they come again with the next read. */
+static int session_stream(CGXCommunication *comm, CGXDLMSCommon& object, struct element& e, CGXByteBuffer& selects, struct session_rows& sink, int& recovers) {
+	size_t size = sink.rows.size();
+	unsigned long count = sink.count;
+	int ret;
+
+	/* The link is given up. */
+	if(recovers > SESSION_RECOVER) {
+		return DLMS_ERROR_CODE_RECEIVE_FAILED;
+	}
+	for(;;) {
+		if((ret = comm->ReadRows(&object, e.index, &selects, sink)) == DLMS_ERROR_CODE_OK) {
+			return ret;
+		}
+		sink.rows.resize(size);
+		sink.count = count;
+		if(!session_lost(ret) || (session_recover(comm, recovers) != 0)) {
+			return ret;
+		}
+	}
+}
+
+/* Compile the selector of a profile, the capture objects of its columns are read for a read by range. */
+static int session_plan(CGXCommunication *comm, struct element& e, uint8_t select, int& recovers) {
+	std::string selected;
+	int ret;
+
+	if(select == PROFILE_BY_ENTRY && e.plan.entry.empty()) {
+		profile_compile(e, select);
+	}
+	else if(select == PROFILE_BY_RANGE && e.plan.range.empty()) {
+		if(!e.columns.empty() && ((ret = session_columns(comm, e, selected, recovers)) != DLMS_ERROR_CODE_OK)) {
+			return ret;
+		}
+		profile_compile(e, select, selected);
+	}
+	return DLMS_ERROR_CODE_OK;
+}
+
+/* Read an attribute which doesn't change, like the capture objects of a profile or the scaler of a register.
+ * The value is kept in the state file, it is read from the meter only when it is not there or fresh is set. */
+static int session_static(CGXCommunication *comm, struct element& e, const std::map<std::string, std::string>& state, std::map<std::string, std::string>& updates, bool fresh, std::string& value, int& recovers) {
+	char index[8];
+	CGXByteBuffer none, bb;
+	int ret;
+
+	snprintf(index, sizeof(index), "%u", (unsigned int)e.index);
+	std::string key = "static." + e.obis + "." + index;
+	std::map<std::string, std::string>::const_iterator it = state.find(key);
+	if(!fresh && (it != state.end()) && (bb.SetHexString(it->second) == 0) && (bb.GetSize() != 0)) {
+		value.assign(reinterpret_cast<const char *>(bb.GetData()), bb.GetSize());
+		return DLMS_ERROR_CODE_OK;
+	}
+	if((ret = session_read(comm, e, none, value, recovers)) != DLMS_ERROR_CODE_OK) {
+		return ret;
+	}
+	bb.Clear();
+	bb.Set(value.data(), value.size());
+	updates[key] = bb.ToHexString(0, bb.GetSize(), false);
+	return DLMS_ERROR_CODE_OK;
+}
+
+/* Get an unsigned number of 32 bits out of its A-XDR encoding. Returns false if it is not one. */
+static bool session_number(const std::string& value, long long& n) {
+	const unsigned char *data = reinterpret_cast<const unsigned char *>(value.data());
+
+	if((value.size() != 5) || (data[0] != DLMS_DATA_TYPE_UINT32)) {
+		return false;
+	}
+	n = ((long long)data[1] << 24) | (data[2] << 16) | (data[3] << 8) | data[4];
+	return true;
+}
+
+/* Get the entries in use of the buffer of a profile, attribute 7, and its size, attribute 8 which doesn't change. */
+static int session_entries(CGXCommunication *comm, struct element& e, const std::map<std::string, std::string>& state, std::map<std::string, std::string>& updates, long long& entries, long long& size, int& recovers) {
+	struct element attribute = e;
+	CGXByteBuffer none;
+	std::string value;
+	int ret;
+
+	attribute.index = 7;
+	if((ret = session_read(comm, attribute, none, value, recovers)) != DLMS_ERROR_CODE_OK) {
+		return ret;
+	}
+	if(!session_number(value, entries)) {
+		return DLMS_ERROR_CODE_INVALID_RESPONSE;
+	}
+	attribute.index = 8;
+	if((ret = session_static(comm, attribute, state, updates, false, value, recovers)) != DLMS_ERROR_CODE_OK) {
+		return ret;
+	}
+	if(!session_number(value, size)) {
+		return DLMS_ERROR_CODE_INVALID_RESPONSE;
+	}
+	return DLMS_ERROR_CODE_OK;
+}
+
+/* Read a profile in chunks of its range, one request for each over the same association.
+ * Only the reply of one chunk is buffered in the client, a chunk which fails is read again
+ * alone. The rows are taken out of the blocks as they arrive and joined into one array.
+ * After a failure result holds the rows of the chunks before it. base is the entry before
+ * the first row of an incremental profile by entry. */
+static int session_profile(CGXCommunication *comm, struct parameter& p, struct element& e, const std::map<std::string, std::string>& state, std::map<std::string, std::string>& updates, std::string& result, long long& base, int& recovers) {
+	CGXByteBuffer selects;
+	CGXDLMSCommon object(e.classID, e.obis.data());
+	struct session_rows sink;
+	long long from, to, end, size, entries = 0;
+	uint8_t select = e.select;
+	int ret = DLMS_ERROR_CODE_OK;
+
+	result.clear();
+	base = 0;
+	if(e.mark && (e.select == PROFILE_BY_ENTRY)) {
+		long long buffer;
+		if((ret = session_entries(comm, e, state, updates, entries, buffer, recovers)) != DLMS_ERROR_CODE_OK) {
+			return ret;
+		}
+		int resync = profile_resync(state, e, entries, buffer, from, to);
+		if(resync < 0) {
+			fprintf(stderr, "Profile %s is full and has no capture time, read it with auto\n", e.obis.data());
+			return DLMS_ERROR_CODE_INVALID_PARAMETER;
+		}
+		if(resync == 0) {
+			result.assign(1, (char)DLMS_DATA_TYPE_ARRAY);
+			CGXAxdr::SetLength(0, result);
+			return DLMS_ERROR_CODE_OK;
+		}
+		select = (uint8_t)resync;
+		base = from - 1;
+	}
+	else if(!profile_bounds(state, e, from, to)) {
+		/* The whole buffer with columns is read by entry. */
+		select = e.columns.empty() ? 0 : PROFILE_BY_ENTRY;
+		from = 1;
+		to = 0;
+	}
+	/* By entry the meter sends the columns from the first to the last one, the others are dropped here. */
+	if((select == PROFILE_BY_ENTRY) && !e.columns.empty() &&
+		(e.columns.back() - e.columns.front() + 1u != e.columns.size())) {
+		sink.columns = &e.columns;
+	}
+	if((ret = session_plan(comm, e, select, recovers)) != DLMS_ERROR_CODE_OK) {
+		return ret;
+	}
+	size = select == PROFILE_BY_RANGE ? p.chunk : p.rows;
+	long long now = (long long)time(NULL);
+	for(;;) {
+		/* The to entry 0 is the last entry, the chunks go on until one is not full. */
+		end = to;
+		if((select != 0) && (size != 0) && ((to == 0) || (to - from >= size))) {
+			end = from + size - 1;
+			/* The range of an incremental read reaches past the clock, the chunk which reaches now takes
+			 * the rest of it instead of a request for the future alone. */
+			if((select == PROFILE_BY_RANGE) && (end >= now)) {
+				end = to;
+			}
+		}
+		if(select == PROFILE_BY_RANGE) {
+			profile_range(e, selects, from, end);
+		}
+		else if(select == 0) {
+			selects.Clear();
+		}
+		else {
+			profile_entry(e, selects, from, end);
+		}
+		unsigned long count = sink.count;
+		if((ret = session_stream(comm, object, e, selects, sink, recovers)) != DLMS_ERROR_CODE_OK) {
+			break;
+		}
+		if((end == to) || ((to == 0) && ((long long)(sink.count - count) < size))) {
+			break;
+		}
+		from = end + 1;
+	}
+	/* Read by capture time the rows are the newest entries of the buffer. */
+	if(e.mark && (e.select == PROFILE_BY_ENTRY) && (select == PROFILE_BY_RANGE)) {
+		base = entries - (long long)sink.count;
+	}
+	if((ret == DLMS_ERROR_CODE_OK) || (sink.count != 0)) {
+		/* The header goes in front of the rows, they are moved into the result and not copied. */
+		std::string header(1, (char)DLMS_DATA_TYPE_ARRAY);
+		CGXAxdr::SetLength(sink.count, header);
+		sink.rows.insert(0, header);
+		result.swap(sink.rows);
+	}
+	return ret;
+}
+
+/* Set up the columns of a profile for the decoder, from its capture objects and the scalers of its registers. */
+static int session_decoder(CGXCommunication *comm, struct element& e, const std::map<std::string, std::string>& state, std::map<std::string, std::string>& updates, bool fresh, CGXProfileDecoder& decoder, int& recovers) {
+	struct element capture = e;
+	std::string objects, selected, scaler;
+	int ret;
+
+	capture.index = 3;
+	if((ret = session_static(comm, capture, state, updates, fresh, objects, recovers)) != DLMS_ERROR_CODE_OK) {
+		return ret;
+	}
+	/* The rows hold only the selected columns. */
+	if(!e.columns.empty()) {
+		if(!session_select(objects, e.columns, selected)) {
+			return DLMS_ERROR_CODE_INVALID_PARAMETER;
+		}
+		objects.swap(selected);
+	}
+	if(!decoder.SetCaptureObjects(reinterpret_cast<const unsigned char *>(objects.data()), objects.size())) {
+		return DLMS_ERROR_CODE_INVALID_RESPONSE;
+	}
+	for(size_t c = 0; c < decoder.GetColumns().size(); c++) {
+		const CGXProfileDecoder::Column& column = decoder.GetColumns()[c];
+		struct element reg;
+		int index = CGXProfileDecoder::GetScalerAttribute(column.classId, column.attribute);
+		if(index == 0) {
+			continue;
+		}
+		reg.classID = column.classId;
+		reg.obis = column.logicalName;
+		reg.index = index;
+		if((ret = session_static(comm, reg, state, updates, fresh, scaler, recovers)) != DLMS_ERROR_CODE_OK) {
+			return ret;
+		}
+		if(!decoder.SetScaler(c, reinterpret_cast<const unsigned char *>(scaler.data()), scaler.size())) {
+			return DLMS_ERROR_CODE_INVALID_RESPONSE;
+		}
+	}
+	return DLMS_ERROR_CODE_OK;
+}
+
+/* Decode the rows of a profile into typed columns, append them to the file of the profile in the decode directory
+ * and to its series in the store. If the rows don't match the kept capture objects, the profile was set up again
+ * and they are read again. */
+static void session_decode(CGXCommunication *comm, struct parameter& p, struct element& e, const std::map<std::string, std::string>& state, std::map<std::string, std::string>& updates, const std::string& result, int& recovers) {
+	const unsigned char *data = reinterpret_cast<const unsigned char *>(result.data());
+	CGXProfileDecoder decoder;
+	char index[8];
+	int ret;
+
+	for(int fresh = 0; ; fresh ++) {
+		ret = session_decoder(comm, e, state, updates, fresh != 0, decoder, recovers);
+		if((ret == DLMS_ERROR_CODE_OK) && decoder.Decode(data, result.size())) {
+			break;
+		}
+		/* A kept value which can't be parsed is read again like capture objects which don't match. */
+		if(fresh || (p.state.empty()) ||
+			((ret != DLMS_ERROR_CODE_OK) && (ret != DLMS_ERROR_CODE_INVALID_RESPONSE) && (ret != DLMS_ERROR_CODE_INVALID_PARAMETER))) {
+			if(ret != DLMS_ERROR_CODE_OK) {
+				fprintf(stderr, "Failed to get the columns of profile %s (%d)\n", e.obis.data(), ret);
+			}
+			else {
+				fprintf(stderr, "Profile %s doesn't match its capture objects\n", e.obis.data());
+			}
+			return;
+		}
+		/* The selected values of the compiled selector may be of the old capture objects too. */
+		e.plan = element_plan();
+		decoder.Clear();
+	}
+
+	if(!p.store.empty() && (decoder.GetRows() != 0)) {
+		std::string series = CGXStore::GetSeries(p.name, e.obis, e.index);
+		if((ret = CGXStore::Append(p.store, series, decoder)) != 0) {
+			fprintf(stderr, "Failed to store %s (%d)\n", series.data(), ret);
+		}
+	}
+	if(p.decode.empty()) {
+		return;
+	}
+	snprintf(index, sizeof(index), "%u", (unsigned int)e.index);
+	std::string path = CGXStateFile::GetPath(p.decode, p.name + "_" + e.obis + "_" + index, ".col");
+	FILE *f = fopen(path.data(), "ab");
+	if(f == NULL) {
+		fprintf(stderr, "Failed to open %s\n", path.data());
+		return;
+	}
+	if((ret = decoder.Write(f)) != 0) {
+		fprintf(stderr, "Failed to write %s (%d)\n", path.data(), ret);
+	}
+	fclose(f);
+}
+
+/* Read the rows of a profile which are missing in the store, one read by range for each gap.
+ * The gaps are looked for in the backfill window from the last check on, the check moves on
+ * only when all gaps were read. Rows which the meter doesn't have any more are not asked again. */
+static void session_backfill(CGXCommunication *comm, struct parameter& p, struct element& e, const std::map<std::string, std::string>& state, std::map<std::string, std::string>& updates, int& recovers) {
+	struct element period = e;
+	std::string value, result;
+	std::vector<long long> times;
+	std::vector<std::pair<long long, long long>> gaps;
+	char index[8];
+	int ret;
+
+	/* Attribute 4 of a profile is its capture period in seconds, 0 captures on events only. */
+	period.index = 4;
+	if((ret = session_static(comm, period, state, updates, false, value, recovers)) != DLMS_ERROR_CODE_OK) {
+		fprintf(stderr, "Failed to get the capture period of profile %s (%d)\n", e.obis.data(), ret);
+		return;
+	}
+	long long seconds;
+	if(!session_number(value, seconds)) {
+		fprintf(stderr, "Profile %s has no capture period\n", e.obis.data());
+		return;
+	}
+	if(seconds == 0) {
+		return;
+	}
+
+	snprintf(index, sizeof(index), "%u", (unsigned int)e.index);
+	std::string key = "backfill." + e.obis + "." + index;
+	long long now = (long long)time(NULL), from = now - p.backfill;
+	std::map<std::string, std::string>::const_iterator it = state.find(key);
+	if((it != state.end()) && (strtoll(it->second.data(), NULL, 10) >= from)) {
+		from = strtoll(it->second.data(), NULL, 10) + 1;
+	}
+	std::string series = CGXStore::GetSeries(p.name, e.obis, e.index);
+	if((ret = CGXStore::GetTimes(p.store, series, from, now, times)) != 0) {
+		fprintf(stderr, "Failed to check %s for gaps (%d)\n", series.data(), ret);
+		return;
+	}
+	profile_gaps(times, seconds, from, gaps);
+
+	/* The gaps are read like the element itself, only the range differs. The selector is compiled
+	 * on the element, so it is kept for the next sessions. */
+	if(!gaps.empty() && ((ret = session_plan(comm, e, PROFILE_BY_RANGE, recovers)) != DLMS_ERROR_CODE_OK)) {
+		fprintf(stderr, "Failed to backfill profile %s (%d)\n", e.obis.data(), ret);
+		return;
+	}
+	unsigned long rows = 0;
+	for(std::vector<std::pair<long long, long long>>::iterator gap = gaps.begin(); gap != gaps.end(); gap++) {
+		struct element g = e;
+		g.select = PROFILE_BY_RANGE;
+		g.from = gap->first;
+		g.to = gap->second;
+		g.mark = false;
+		long long base;
+		ret = session_profile(comm, p, g, state, updates, result, base, recovers);
+		if(!result.empty()) {
+			std::vector<unsigned long> offsets;
+			CGXAxdr::GetRows(reinterpret_cast<const unsigned char *>(result.data()), result.size(), offsets);
+			rows += offsets.size();
+			session_decode(comm, p, g, state, updates, result, recovers);
+		}
+		if(ret != DLMS_ERROR_CODE_OK) {
+			fprintf(stderr, "Failed to backfill profile %s (%d)\n", e.obis.data(), ret);
+			return;
+		}
+	}
+	if(!gaps.empty()) {
+		fprintf(stderr, "Backfilled %lu rows of profile %s in %u gaps\n", rows, e.obis.data(), (unsigned int)gaps.size());
+	}
+	if(!times.empty()) {
+		char mark[24];
+		snprintf(mark, sizeof(mark), "%lld", times.back());
+		updates[key] = mark;
+	}
+}
+
+/* Get the key of the checkpoint of a range which is read in chunks. */
+static std::string session_checkpoint(const struct element& e) {
+	char index[8];
+
+	snprintf(index, sizeof(index), "%u", (unsigned int)e.index);
+	return "range." + e.obis + "." + index;
+}
+
+/* Get where a range goes on after a read which failed, the checkpoint keeps the range and its last row read.
+ * Returns false if the range starts from its beginning. */
+static bool session_resume(const std::map<std::string, std::string>& state, const struct element& e, long long& from) {
+	long long first, last, done;
+	std::map<std::string, std::string>::const_iterator it = state.find(session_checkpoint(e));
+
+	if((it == state.end()) || (sscanf(it->second.data(), "%lld-%lld:%lld", &first, &last, &done) != 3) ||
+		(first != e.from) || (last != e.to) || (done < e.from) || (done >= e.to)) {
+		return false;
+	}
+	from = done + 1;
+	return true;
+}
+
+int session_run(struct parameter& p, std::string& line, struct session_stat& st, int socket, const CGXRetryPolicy *retry, const CGXKeyStore::Keys *keys) {
+	/* A meter of a fleet with a key store may have no keys of its own. */
+	if((p.level == DLMS_AUTHENTICATION_HIGH_GMAC) && (keys == nullptr) &&
+		((p.ekey.GetSize() != 16) || (p.akey.GetSize() != 16))) {
+		st.meters ++;
+		st.failures ++;
+		if(socket != -1) {
+			CGXConnector::Close(socket);
+		}
+		fprintf(stderr, "No keys for %s\n", p.name.data());
+		return DLMS_ERROR_CODE_INVALID_PARAMETER;
+	}
+
+	CGXDLMSSecureClient *cl = session_client(p, keys);
+	int ret;
+
+	CGXCommunication *comm;
+	comm = new CGXCommunication(cl, 6000, GX_TRACE_LEVEL_OFF, p.counter.empty() ? nullptr : &p.counter[0]);
+	if(!p.state.empty()) {
+		comm->SetStateFile(CGXStateFile::GetPath(p.state, p.name));
+	}
+	/* The daemon schedules the session again instead of waiting in the worker. */
+	if(retry != nullptr) {
+		comm->SetRetryPolicy(*retry, false);
+	}
+
+	st.meters ++;
+
+	std::string host;
+	unsigned short port;
+	bool tcp = device_tcp(p.device, host, port);
+	if(socket != -1) {
+		/* Already connected by the fleet daemon. */
+		comm->Attach(socket, host.data(), port);
+	}
+	else if(tcp) {
+		if(comm->Connect(host.data(), port) != 0) {
+			delete comm;
+			delete cl;
+			st.failures ++;
+			fprintf(stderr, "Failed to connect to %s\n", p.device.data());
+			return -1;
+		}
+	}
+	else if(comm->Open(p.device.data(), p.negotiate, 115200) != 0) {
+		delete comm;
+		delete cl;
+		st.failures ++;
+		fprintf(stderr, "Failed to open device\n");
+		return -1;
+	}
+
+    if((ret = comm->InitializeConnection()) != 0) {
+        comm->Close();
+        delete comm;
+        delete cl;
+		st.failures ++;
+		fprintf(stderr, "Failed to initialize the link layer\n");
+        return ret;
+    }
+
+	/* Elements without selective access are read together with GET-with-list requests. */
+	std::vector<CGXDLMSCommon *> objects;
+	std::vector<std::pair<CGXDLMSObject *, unsigned char>> list;
+	std::vector<size_t> position;
+	for(size_t i = 0; i < p.elements.size(); i++) {
+		if(p.elements[i].select == 0) {
+			objects.push_back(new CGXDLMSCommon(p.elements[i].classID, p.elements[i].obis.data()));
+			list.push_back(std::make_pair(objects.back(), p.elements[i].index));
+			position.push_back(i);
+		}
+	}
+
+	/* Result of each element, -1 means it is not read yet. */
+	std::vector<int> errors(p.elements.size(), -1);
+	std::vector<std::string> results(p.elements.size());
+	std::vector<long long> bases(p.elements.size(), 0);
+	int recovers = 0;
+
+	/* Marks of the incremental profiles, they are moved only after a read.
+	 * The capture objects and the scalers of decoded profiles are kept with them. */
+	std::string path;
+	std::map<std::string, std::string> state, marks;
+	for(size_t i = 0; i < p.elements.size(); i++) {
+		if(p.elements[i].mark || ((p.elements[i].select != 0 || !p.decode.empty() || !p.store.empty()) && !p.state.empty())) {
+			path = CGXStateFile::GetPath(p.state, p.name);
+			CGXStateFile::Load(path, state);
+			break;
+		}
+	}
+	if(list.size() > 1) {
+		std::vector<std::string> values;
+		std::vector<int> codes;
+		/* Meters which reject the list get the rest of the elements one by one. */
+		int err = comm->ReadList(list, values, codes);
+		if(session_lost(err)) {
+			session_recover(comm, recovers);
+		}
+		for(size_t i = 0; i < values.size(); i++) {
+			results[position[i]] = values[i];
+			errors[position[i]] = codes[i];
+		}
+	}
+	for(std::vector<CGXDLMSCommon *>::iterator iter = objects.begin(); iter != objects.end(); iter++) {
+		delete *iter;
+	}
+
+	ret = 0;
+	for(size_t i = 0; i < p.elements.size(); i++) {
+		struct element& e = p.elements[i];
+
+		/* After a lost link the read continues from this element on a new association. */
+		if(errors[i] == -1) {
+			CGXByteBuffer selects;
+			if(e.mark) {
+				errors[i] = session_profile(comm, p, e, state, marks, results[i], bases[i], recovers);
+			}
+			else if(e.select != 0) {
+				/* A range which failed before goes on after its last row, the rows before it were written then. */
+				struct element r = e;
+				bool resumed = !path.empty() && session_resume(state, e, r.from);
+				errors[i] = session_profile(comm, p, r, state, marks, results[i], bases[i], recovers);
+				e.plan = r.plan;
+				long long last;
+				char value[64];
+				if(resumed && (errors[i] == DLMS_ERROR_CODE_OK)) {
+					marks[session_checkpoint(e)] = "";
+				}
+				else if(!path.empty() && (errors[i] != DLMS_ERROR_CODE_OK) && profile_last(r, results[i], r.from - 1, last)) {
+					snprintf(value, sizeof(value), "%lld-%lld:%lld", e.from, e.to, last);
+					marks[session_checkpoint(e)] = value;
+				}
+			}
+			else {
+				errors[i] = session_read(comm, e, selects, results[i], recovers);
+			}
+		}
+
+		/* Reported to the daemon, which may try the session again. */
+		if((errors[i] != DLMS_ERROR_CODE_OK) && (ret == 0) &&
+			(CGXRetryPolicy::Classify(errors[i]) != CGXRetryPolicy::RETRY_NONE)) {
+			ret = errors[i];
+		}
+		/* A refused read may come from a stale selector, it is compiled again on the next read. */
+		if((errors[i] != DLMS_ERROR_CODE_OK) && (CGXRetryPolicy::Classify(errors[i]) == CGXRetryPolicy::RETRY_NONE)) {
+			e.plan = element_plan();
+		}
+		/* The rows of a profile read before a failure are kept, its mark or its checkpoint moves past them. */
+		if((errors[i] != DLMS_ERROR_CODE_OK) && ((e.select == 0) || results[i].empty())) {
+			line.append("NULL ");
+		}
+		else {
+			CGXHex::Append(reinterpret_cast<const unsigned char *>(results[i].data()), results[i].size(), line);
+			line.append(" ");
+			st.elements ++;
+			if(e.mark) {
+				profile_advance(e, results[i], bases[i], marks);
+			}
+			if((!p.decode.empty() || !p.store.empty()) && (e.classID == 7) && (e.index == 2)) {
+				session_decode(comm, p, e, state, marks, results[i], recovers);
+			}
+			if((p.backfill != 0) && (e.classID == 7) && (e.index == 2)) {
+				session_backfill(comm, p, e, state, marks, recovers);
+			}
+		}
+	}
+
+	int err;
+	if(!marks.empty() && !path.empty() && ((err = CGXStateFile::Update(path, marks)) != 0)) {
+		fprintf(stderr, "Failed to save the state to %s (%d)\n", path.data(), err);
+	}
+
+	comm->Close();
+	delete comm;
+	delete cl;
+    return ret;
+}
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <errno.h>
+#include "state.h"
+
+#if defined(_WIN32) || defined(_WIN64)//Windows includes
+#include <windows.h>
+#include <io.h>
+#define GXFsync(f) _commit(_fileno(f))
+#else //Linux includes.
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#define GXFsync(f) fsync(fileno(f))
+#endif
+
+//Size of the buffer a line is read with, longer lines are read in parts.
+#define GX_STATE_LINE 1024
+
+//Add the value of a line of a state file.
+static void GXAddLine(std::string& str, std::map<std::string, std::string>& values)
+{
+    while (!str.empty() && (str[str.size() - 1] == '\n' || str[str.size() - 1] == '\r'))
+    {
+        str.erase(str.size() - 1);
+    }
+    std::string::size_type pos = str.find('=');
+    if (pos != std::string::npos && pos != 0)
+    {
+        values[str.substr(0, pos)] = str.substr(pos + 1);
+    }
+    str.clear();
+}
+
+int CGXStateFile::Load(const std::string& path, std::map<std::string, std::string>& values)
+{
+    char line[GX_STATE_LINE];
+    std::string str;
+    values.clear();
+    FILE* f = fopen(path.c_str(), "r");
+    if (f == NULL)
+    {
+        return errno == ENOENT ? 0 : errno;
+    }
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        //Values like the capture objects of a profile are longer than the buffer.
+        str.append(line);
+        if (str[str.size() - 1] == '\n')
+        {
+            GXAddLine(str, values);
+        }
+    }
+    //Last line without a line feed.
+    GXAddLine(str, values);
+    fclose(f);
+    return 0;
+}
+
+//Write all values to a temporary file, flush it and move it over the state file.
+static int GXReplace(const std::string& path, const std::map<std::string, std::string>& values)
+{
+    int ret = 0;
+    std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (f == NULL)
+    {
+        return errno;
+    }
+    for (std::map<std::string, std::string>::const_iterator it = values.begin(); it != values.end(); ++it)
+    {
+        if (fprintf(f, "%s=%s\n", it->first.c_str(), it->second.c_str()) < 0)
+        {
+            ret = errno;
+            break;
+        }
+    }
+    if (ret == 0 && (fflush(f) != 0 || GXFsync(f) != 0))
+    {
+        ret = errno;
+    }
+    if (fclose(f) != 0 && ret == 0)
+    {
+        ret = errno;
+    }
+    if (ret != 0)
+    {
+        remove(tmp.c_str());
+        return ret;
+    }
+#if defined(_WIN32) || defined(_WIN64)//Windows
+    if (!MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    {
+        remove(tmp.c_str());
+        return (int)GetLastError();
+    }
+#else
+    if (rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        ret = errno;
+        remove(tmp.c_str());
+        return ret;
+    }
+    //Flush the directory, so the new name survives a crash.
+    std::string::size_type pos = path.find_last_of('/');
+    std::string dir = pos == std::string::npos ? "." : (pos == 0 ? "/" : path.substr(0, pos));
+    int fd = open(dir.c_str(), O_RDONLY);
+    if (fd != -1)
+    {
+        fsync(fd);
+        close(fd);
+    }
+#endif
+    return 0;
+}
+
+int CGXStateFile::Update(const std::string& path, const std::map<std::string, std::string>& values)
+{
+    int ret;
+    std::map<std::string, std::string> current;
+    //The state file itself is replaced, so the lock is taken on a file of its own.
+    std::string lock = path + ".lock";
+#if defined(_WIN32) || defined(_WIN64)//Windows
+    HANDLE h = CreateFileA(lock.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE)
+    {
+        return (int)GetLastError();
+    }
+    OVERLAPPED ov;
+    ZeroMemory(&ov, sizeof(ov));
+    if (!LockFileEx(h, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov))
+    {
+        ret = (int)GetLastError();
+        CloseHandle(h);
+        return ret;
+    }
+#else
+    int fd = open(lock.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd == -1)
+    {
+        return errno;
+    }
+    while (flock(fd, LOCK_EX) != 0)
+    {
+        if (errno != EINTR)
+        {
+            ret = errno;
+            close(fd);
+            return ret;
+        }
+    }
+#endif
+    if ((ret = Load(path, current)) == 0)
+    {
+        for (std::map<std::string, std::string>::const_iterator it = values.begin(); it != values.end(); ++it)
+        {
+            current[it->first] = it->second;
+        }
+        ret = GXReplace(path, current);
+    }
+#if defined(_WIN32) || defined(_WIN64)//Windows
+    UnlockFileEx(h, 0, 1, 0, &ov);
+    CloseHandle(h);
+#else
+    flock(fd, LOCK_UN);
+    close(fd);
+#endif
+    return ret;
+}
+
+int CGXStateFile::Update(const std::string& path, const std::string& key, const std::string& value)
+{
+    std::map<std::string, std::string> values;
+    values[key] = value;
+    return Update(path, values);
+}
+
+std::string CGXStateFile::GetPath(const std::string& directory, const std::string& name, const char* extension)
+{
+    std::string file = name;
+    for (std::string::iterator it = file.begin(); it != file.end(); ++it)
+    {
+        if (*it == '/' || *it == '\\' || *it == ':' || *it == '[' || *it == ']' || *it == ' ')
+        {
+            *it = '_';
+        }
+    }
+    return directory + "/" + file + extension;
+}
@@ -0,0 +1,30 @@
+#ifndef GXSTATE_H
+#define GXSTATE_H
+
+#include <string>
+#include <map>
+
+//Small key=value files which keep the state of a meter between sessions.
+//Updates are merged under an exclusive lock, written to a temporary file,
+//flushed and renamed over the old file. A crash leaves either the old or the
+//new content, and workers of several processes can update the same file.
+class CGXStateFile
+{
+public:
+    //Read all values of a state file. A missing file has no values.
+    //Returns 0 or the system error.
+    static int Load(const std::string& path, std::map<std::string, std::string>& values);
+
+    //Merge values into a state file, other values of the file are kept.
+    //Returns 0 or the system error.
+    static int Update(const std::string& path, const std::map<std::string, std::string>& values);
+
+    //Update one value.
+    static int Update(const std::string& path, const std::string& key, const std::string& value);
+
+    //Get the path of the state file of a meter in a directory.
+    //Characters which can't be used in a file name are replaced.
+    static std::string GetPath(const std::string& directory, const std::string& name, const char* extension = ".state");
+};
+
+#endif //GXSTATE_H
@@ -0,0 +1,737 @@
+#include <stdio.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "store.h"
+#include "state.h"
+#include "hex.h"
+#include "mapfile.h"
+
+#if defined(_WIN32) || defined(_WIN64)//Windows includes
+#include <windows.h>
+#include <io.h>
+#include <direct.h>
+#define GXFsync(f) _commit(_fileno(f))
+#define GXTruncate(f, size) _chsize(_fileno(f), size)
+#define GXMkdir(path) _mkdir(path)
+#else //Linux includes.
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#define GXFsync(f) fsync(fileno(f))
+#define GXTruncate(f, size) ftruncate(fileno(f), size)
+#define GXMkdir(path) mkdir(path, 0755)
+#endif
+
+//A new segment is started when the last one has grown this big.
+#define GX_STORE_SEGMENT (4 * 1024 * 1024)
+//Size of a record in the index.
+#define GX_STORE_RECORD 32
+
+//Exclusive lock on a file of a series, held while a block is appended.
+class GXLock
+{
+#if defined(_WIN32) || defined(_WIN64)//Windows
+    HANDLE m_Handle;
+    OVERLAPPED m_Overlapped;
+public:
+    GXLock() : m_Handle(INVALID_HANDLE_VALUE)
+    {
+    }
+
+    int Lock(const std::string& path)
+    {
+        m_Handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+            NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (m_Handle == INVALID_HANDLE_VALUE)
+        {
+            return (int)GetLastError();
+        }
+        ZeroMemory(&m_Overlapped, sizeof(m_Overlapped));
+        if (!LockFileEx(m_Handle, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &m_Overlapped))
+        {
+            int ret = (int)GetLastError();
+            CloseHandle(m_Handle);
+            m_Handle = INVALID_HANDLE_VALUE;
+            return ret;
+        }
+        return 0;
+    }
+
+    ~GXLock()
+    {
+        if (m_Handle != INVALID_HANDLE_VALUE)
+        {
+            UnlockFileEx(m_Handle, 0, 1, 0, &m_Overlapped);
+            CloseHandle(m_Handle);
+        }
+    }
+#else
+    int m_Fd;
+public:
+    GXLock() : m_Fd(-1)
+    {
+    }
+
+    int Lock(const std::string& path)
+    {
+        m_Fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (m_Fd == -1)
+        {
+            return errno;
+        }
+        while (flock(m_Fd, LOCK_EX) != 0)
+        {
+            if (errno != EINTR)
+            {
+                int ret = errno;
+                close(m_Fd);
+                m_Fd = -1;
+                return ret;
+            }
+        }
+        return 0;
+    }
+
+    ~GXLock()
+    {
+        if (m_Fd != -1)
+        {
+            flock(m_Fd, LOCK_UN);
+            close(m_Fd);
+        }
+    }
+#endif
+};
+
+//Column of a block, as it is read back.
+struct GXColumn
+{
+    int type;
+    std::string name;
+    std::vector<long long> integers;
+    std::vector<double> reals;
+    std::vector<std::string> raws;
+};
+
+static void GXPutVarint(std::string& out, unsigned long long value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+static bool GXGetVarint(const unsigned char* data, unsigned long size, unsigned long& pos, unsigned long long& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (pos == size)
+        {
+            return false;
+        }
+        unsigned char ch = data[pos++];
+        value |= (unsigned long long)(ch & 0x7F) << shift;
+        if ((ch & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+//Signed numbers are stored so that small negative numbers are short too.
+static unsigned long long GXZigzag(long long value)
+{
+    return ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+}
+
+static long long GXUnzigzag(unsigned long long value)
+{
+    return (long long)(value >> 1) ^ -(long long)(value & 1);
+}
+
+static void GXPutNumber(std::string& out, unsigned long long value, int count)
+{
+    for (int i = 0; i != count; ++i)
+    {
+        out.push_back((char)(value >> (8 * i)));
+    }
+}
+
+static unsigned long long GXGetNumber(const unsigned char* data, int count)
+{
+    unsigned long long value = 0;
+    for (int i = count - 1; i >= 0; --i)
+    {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+//Put which rows of a column have a value, a column without missing values has no bitmap.
+static void GXPutPresent(std::string& out, const std::vector<bool>& present)
+{
+    bool all = true;
+    for (size_t i = 0; i != present.size() && all; ++i)
+    {
+        all = present[i];
+    }
+    out.push_back(all ? 0 : 1);
+    if (!all)
+    {
+        std::string bitmap((present.size() + 7) / 8, 0);
+        for (size_t i = 0; i != present.size(); ++i)
+        {
+            if (present[i])
+            {
+                bitmap[i / 8] |= (char)(1 << (i % 8));
+            }
+        }
+        out.append(bitmap);
+    }
+}
+
+static bool GXGetPresent(const unsigned char* data, unsigned long size, unsigned long& pos, unsigned long rows, std::vector<bool>& present)
+{
+    present.assign(rows, true);
+    if (pos == size)
+    {
+        return false;
+    }
+    if (data[pos++] == 0)
+    {
+        return true;
+    }
+    if (size - pos < (rows + 7) / 8)
+    {
+        return false;
+    }
+    for (unsigned long i = 0; i != rows; ++i)
+    {
+        present[i] = (data[pos + i / 8] & (1 << (i % 8))) != 0;
+    }
+    pos += (rows + 7) / 8;
+    return true;
+}
+
+//Encode the rows of a decoder as a block and get the range of their capture times.
+static void GXEncode(const CGXProfileDecoder& rows, std::string& out, long long& first, long long& last)
+{
+    const std::vector<CGXProfileDecoder::Column>& columns = rows.GetColumns();
+    bool found = false;
+    out.assign("GXB1");
+    GXPutVarint(out, rows.GetRows());
+    GXPutVarint(out, columns.size());
+    for (std::vector<CGXProfileDecoder::Column>::const_iterator it = columns.begin(); it != columns.end(); ++it)
+    {
+        char name[48];
+        int len = snprintf(name, sizeof(name), "%u/%s/%d", it->classId, it->logicalName.c_str(), it->attribute);
+        out.push_back((char)it->type);
+        out.push_back((char)len);
+        out.append(name, len);
+        std::vector<bool> present(rows.GetRows());
+        if (it->type == CGXProfileDecoder::COLUMN_TIME || it->type == CGXProfileDecoder::COLUMN_INTEGER)
+        {
+            for (unsigned long row = 0; row != rows.GetRows(); ++row)
+            {
+                present[row] = it->integers[row] != CGXProfileDecoder::MISSING;
+            }
+            GXPutPresent(out, present);
+            //Times are captured at a fixed period, the delta of the deltas is mostly 0.
+            unsigned long long prev = 0, delta = 0;
+            for (unsigned long row = 0; row != rows.GetRows(); ++row)
+            {
+                if (!present[row])
+                {
+                    continue;
+                }
+                unsigned long long value = (unsigned long long)it->integers[row];
+                if (it->type == CGXProfileDecoder::COLUMN_INTEGER)
+                {
+                    GXPutVarint(out, GXZigzag((long long)(value - prev)));
+                }
+                else
+                {
+                    GXPutVarint(out, GXZigzag((long long)(value - prev - delta)));
+                    delta = value - prev;
+                    if (!found || it->integers[row] < first)
+                    {
+                        first = it->integers[row];
+                    }
+                    if (!found || it->integers[row] > last)
+                    {
+                        last = it->integers[row];
+                    }
+                    found = true;
+                }
+                prev = value;
+            }
+        }
+        else if (it->type == CGXProfileDecoder::COLUMN_REAL)
+        {
+            for (unsigned long row = 0; row != rows.GetRows(); ++row)
+            {
+                present[row] = !isnan(it->reals[row]);
+            }
+            GXPutPresent(out, present);
+            //Only the bytes which differ from the value before are kept.
+            unsigned long long prev = 0;
+            for (unsigned long row = 0; row != rows.GetRows(); ++row)
+            {
+                if (!present[row])
+                {
+                    continue;
+                }
+                unsigned long long bits;
+                memcpy(&bits, &it->reals[row], sizeof(bits));
+                unsigned long long x = bits ^ prev;
+                prev = bits;
+                if (x == 0)
+                {
+                    out.push_back(0);
+                    continue;
+                }
+                int lead = 0, trail = 0;
+                while ((x >> (56 - 8 * lead)) == 0)
+                {
+                    ++lead;
+                }
+                while (((x >> (8 * trail)) & 0xFF) == 0)
+                {
+                    ++trail;
+                }
+                int count = 8 - lead - trail;
+                out.push_back((char)((lead << 4) | count));
+                GXPutNumber(out, x >> (8 * trail), count);
+            }
+        }
+        else if (it->type == CGXProfileDecoder::COLUMN_RAW)
+        {
+            for (unsigned long row = 0; row != rows.GetRows(); ++row)
+            {
+                GXPutVarint(out, it->raws[row].size());
+                out.append(it->raws[row]);
+            }
+        }
+    }
+    if (!found)
+    {
+        first = last = (long long)time(NULL);
+    }
+}
+
+//Decode a block into its columns. Returns false if the block is damaged.
+static bool GXDecode(const unsigned char* data, unsigned long size, unsigned long& rows, std::vector<GXColumn>& columns)
+{
+    unsigned long pos = 4;
+    unsigned long long value, count;
+    columns.clear();
+    if (size < 4 || memcmp(data, "GXB1", 4) != 0 || !GXGetVarint(data, size, pos, value) ||
+        !GXGetVarint(data, size, pos, count) || value > size || count > size)
+    {
+        return false;
+    }
+    rows = (unsigned long)value;
+    columns.resize((size_t)count);
+    for (std::vector<GXColumn>::iterator it = columns.begin(); it != columns.end(); ++it)
+    {
+        if (size - pos < 2 || size - pos - 2 < data[pos + 1])
+        {
+            return false;
+        }
+        it->type = data[pos];
+        it->name.assign((const char*)data + pos + 2, data[pos + 1]);
+        pos += 2 + data[pos + 1];
+        std::vector<bool> present;
+        if (it->type == CGXProfileDecoder::COLUMN_TIME || it->type == CGXProfileDecoder::COLUMN_INTEGER)
+        {
+            if (!GXGetPresent(data, size, pos, rows, present))
+            {
+                return false;
+            }
+            unsigned long long prev = 0, delta = 0;
+            it->integers.assign(rows, CGXProfileDecoder::MISSING);
+            for (unsigned long row = 0; row != rows; ++row)
+            {
+                if (!present[row])
+                {
+                    continue;
+                }
+                if (!GXGetVarint(data, size, pos, value))
+                {
+                    return false;
+                }
+                if (it->type == CGXProfileDecoder::COLUMN_TIME)
+                {
+                    delta += (unsigned long long)GXUnzigzag(value);
+                    prev += delta;
+                }
+                else
+                {
+                    prev += (unsigned long long)GXUnzigzag(value);
+                }
+                it->integers[row] = (long long)prev;
+            }
+        }
+        else if (it->type == CGXProfileDecoder::COLUMN_REAL)
+        {
+            if (!GXGetPresent(data, size, pos, rows, present))
+            {
+                return false;
+            }
+            unsigned long long prev = 0;
+            it->reals.assign(rows, NAN);
+            for (unsigned long row = 0; row != rows; ++row)
+            {
+                if (!present[row])
+                {
+                    continue;
+                }
+                if (pos == size)
+                {
+                    return false;
+                }
+                int lead = data[pos] >> 4, count = data[pos] & 0xF;
+                ++pos;
+                if (lead + count > 8 || size - pos < (unsigned long)count)
+                {
+                    return false;
+                }
+                if (count != 0)
+                {
+                    prev ^= GXGetNumber(data + pos, count) << (8 * (8 - lead - count));
+                    pos += count;
+                }
+                memcpy(&it->reals[row], &prev, sizeof(prev));
+            }
+        }
+        else if (it->type == CGXProfileDecoder::COLUMN_RAW)
+        {
+            it->raws.resize(rows);
+            for (unsigned long row = 0; row != rows; ++row)
+            {
+                if (!GXGetVarint(data, size, pos, value) || value > size - pos)
+                {
+                    return false;
+                }
+                it->raws[row].assign((const char*)data + pos, (size_t)value);
+                pos += (unsigned long)value;
+            }
+        }
+        else if (it->type != CGXProfileDecoder::COLUMN_UNKNOWN)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::string GXSegmentPath(const std::string& path, unsigned int segment)
+{
+    char name[16];
+    snprintf(name, sizeof(name), "%08u.seg", segment);
+    return path + "/" + name;
+}
+
+//Append a block to the last segment and its record to the index, the lock of the series is held.
+static int GXAppend(const std::string& path, const std::string& block, CGXStore::Block& b)
+{
+    int ret = 0;
+    std::string index = path + "/index";
+    FILE* f = fopen(index.c_str(), "ab+");
+    if (f == NULL)
+    {
+        return errno;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    b.segment = 0;
+    //A record torn by a crash is dropped, its block is not found any more.
+    if (size % GX_STORE_RECORD != 0)
+    {
+        size -= size % GX_STORE_RECORD;
+        fflush(f);
+        if (GXTruncate(f, size) != 0)
+        {
+            ret = errno;
+            fclose(f);
+            return ret;
+        }
+    }
+    if (size != 0)
+    {
+        unsigned char record[GX_STORE_RECORD];
+        fseek(f, size - GX_STORE_RECORD, SEEK_SET);
+        if (fread(record, 1, sizeof(record), f) != sizeof(record))
+        {
+            ret = ferror(f) ? errno : EINVAL;
+            fclose(f);
+            return ret;
+        }
+        b.segment = (unsigned int)GXGetNumber(record + 16, 4);
+    }
+    FILE* s = fopen(GXSegmentPath(path, b.segment).c_str(), "ab");
+    if (s != NULL)
+    {
+        fseek(s, 0, SEEK_END);
+        if (ftell(s) >= GX_STORE_SEGMENT)
+        {
+            fclose(s);
+            ++b.segment;
+            s = fopen(GXSegmentPath(path, b.segment).c_str(), "ab");
+        }
+    }
+    if (s == NULL)
+    {
+        ret = errno;
+        fclose(f);
+        return ret;
+    }
+    fseek(s, 0, SEEK_END);
+    b.offset = (unsigned int)ftell(s);
+    b.size = (unsigned int)block.size();
+    if (fwrite(block.data(), 1, block.size(), s) != block.size() || fflush(s) != 0 || GXFsync(s) != 0)
+    {
+        ret = errno;
+    }
+    if (fclose(s) != 0 && ret == 0)
+    {
+        ret = errno;
+    }
+    if (ret == 0)
+    {
+        //The record is written after its block, an index never points to a block which is not there.
+        std::string record;
+        GXPutNumber(record, (unsigned long long)b.first, 8);
+        GXPutNumber(record, (unsigned long long)b.last, 8);
+        GXPutNumber(record, b.segment, 4);
+        GXPutNumber(record, b.offset, 4);
+        GXPutNumber(record, b.size, 4);
+        GXPutNumber(record, b.rows, 4);
+        if (fwrite(record.data(), 1, record.size(), f) != record.size() || fflush(f) != 0 || GXFsync(f) != 0)
+        {
+            ret = errno;
+        }
+    }
+    if (fclose(f) != 0 && ret == 0)
+    {
+        ret = errno;
+    }
+    return ret;
+}
+
+std::string CGXStore::GetSeries(const std::string& meter, const std::string& obis, int attribute)
+{
+    char index[8];
+    snprintf(index, sizeof(index), "%d", attribute);
+    //The directory is named like the state file of the meter.
+    std::string path = CGXStateFile::GetPath("", meter + "_" + obis + "_" + index, "");
+    return path.substr(1);
+}
+
+int CGXStore::Append(const std::string& directory, const std::string& series, const CGXProfileDecoder& rows)
+{
+    int ret;
+    std::string path = directory + "/" + series;
+    if ((GXMkdir(directory.c_str()) != 0 && errno != EEXIST) || (GXMkdir(path.c_str()) != 0 && errno != EEXIST))
+    {
+        return errno;
+    }
+    std::string block;
+    Block b;
+    GXEncode(rows, block, b.first, b.last);
+    b.rows = rows.GetRows();
+    GXLock lock;
+    if ((ret = lock.Lock(path + "/lock")) != 0)
+    {
+        return ret;
+    }
+    return GXAppend(path, block, b);
+}
+
+//Walks the blocks of a series which overlap a range of capture times.
+class GXReader
+{
+    std::string m_Path;
+    CGXMappedFile m_Index;
+    CGXMappedFile m_Segment;
+    unsigned int m_Mapped;
+    unsigned long m_Pos;
+public:
+    GXReader() : m_Mapped(0), m_Pos(0)
+    {
+    }
+
+    //Map the index of a series. Returns 0 or the system error.
+    int Open(const std::string& path)
+    {
+        m_Path = path;
+        m_Pos = 0;
+        return m_Index.Open(path + "/index");
+    }
+
+    //Get the next block of the range.
+    //Returns 0, -1 after the last block, EINVAL if a block is damaged or the system error.
+    int Next(long long from, long long to, CGXStore::Block& b, unsigned long& rows, std::vector<GXColumn>& columns)
+    {
+        int ret;
+        for (; m_Index.GetSize() - m_Pos >= GX_STORE_RECORD; m_Pos += GX_STORE_RECORD)
+        {
+            const unsigned char* record = m_Index.GetData() + m_Pos;
+            b.first = (long long)GXGetNumber(record, 8);
+            b.last = (long long)GXGetNumber(record + 8, 8);
+            if (b.last < from || b.first > to)
+            {
+                continue;
+            }
+            m_Pos += GX_STORE_RECORD;
+            b.segment = (unsigned int)GXGetNumber(record + 16, 4);
+            b.offset = (unsigned int)GXGetNumber(record + 20, 4);
+            b.size = (unsigned int)GXGetNumber(record + 24, 4);
+            b.rows = (unsigned int)GXGetNumber(record + 28, 4);
+            //Blocks of a segment follow each other, it stays mapped until the next segment.
+            if (m_Segment.GetData() == NULL || m_Mapped != b.segment)
+            {
+                if ((ret = m_Segment.Open(GXSegmentPath(m_Path, b.segment))) != 0)
+                {
+                    return ret;
+                }
+                m_Mapped = b.segment;
+            }
+            if (b.offset > m_Segment.GetSize() || m_Segment.GetSize() - b.offset < b.size ||
+                !GXDecode(m_Segment.GetData() + b.offset, b.size, rows, columns))
+            {
+                return EINVAL;
+            }
+            return 0;
+        }
+        return -1;
+    }
+};
+
+//Get the column of the capture times of a block, its first time column.
+static const GXColumn* GXGetTimes(const std::vector<GXColumn>& columns)
+{
+    for (std::vector<GXColumn>::const_iterator it = columns.begin(); it != columns.end(); ++it)
+    {
+        if (it->type == CGXProfileDecoder::COLUMN_TIME)
+        {
+            return &*it;
+        }
+    }
+    return NULL;
+}
+
+int CGXStore::GetTimes(const std::string& directory, const std::string& series, long long from, long long to, std::vector<long long>& times)
+{
+    int ret;
+    GXReader reader;
+    Block b;
+    unsigned long rows;
+    std::vector<GXColumn> columns;
+    times.clear();
+    if ((ret = reader.Open(directory + "/" + series)) != 0)
+    {
+        return ret == ENOENT ? 0 : ret;
+    }
+    while ((ret = reader.Next(from, to, b, rows, columns)) == 0)
+    {
+        const GXColumn* column = GXGetTimes(columns);
+        for (unsigned long row = 0; column != NULL && row != rows; ++row)
+        {
+            long long t = column->integers[row];
+            if (t != CGXProfileDecoder::MISSING && t >= from && t <= to)
+            {
+                times.push_back(t);
+            }
+        }
+    }
+    return ret == -1 ? 0 : ret;
+}
+
+int CGXStore::Query(const std::string& directory, const std::string& series, long long from, long long to, FILE* out)
+{
+    int ret;
+    GXReader reader;
+    Block b;
+    unsigned long rows;
+    std::vector<GXColumn> columns;
+    std::string header, line;
+    if ((ret = reader.Open(directory + "/" + series)) != 0)
+    {
+        return ret;
+    }
+    while ((ret = reader.Next(from, to, b, rows, columns)) == 0)
+    {
+        //The columns are named again when the capture objects change.
+        line.assign("#time");
+        for (std::vector<GXColumn>::iterator it = columns.begin(); it != columns.end(); ++it)
+        {
+            line.append("\t" + it->name);
+        }
+        if (line != header)
+        {
+            header = line;
+            fprintf(out, "%s\n", header.c_str());
+        }
+        const GXColumn* time = GXGetTimes(columns);
+        for (unsigned long row = 0; row != rows; ++row)
+        {
+            long long t = time == NULL ? b.first : time->integers[row];
+            char value[32];
+            if (t == CGXProfileDecoder::MISSING || t < from || t > to)
+            {
+                continue;
+            }
+            snprintf(value, sizeof(value), "%lld", t);
+            line.assign(value);
+            for (std::vector<GXColumn>::iterator it = columns.begin(); it != columns.end(); ++it)
+            {
+                line.push_back('\t');
+                switch (it->type)
+                {
+                case CGXProfileDecoder::COLUMN_TIME:
+                case CGXProfileDecoder::COLUMN_INTEGER:
+                    if (it->integers[row] == CGXProfileDecoder::MISSING)
+                    {
+                        line.append("NULL");
+                        break;
+                    }
+                    snprintf(value, sizeof(value), "%lld", it->integers[row]);
+                    line.append(value);
+                    break;
+                case CGXProfileDecoder::COLUMN_REAL:
+                    if (isnan(it->reals[row]))
+                    {
+                        line.append("NULL");
+                        break;
+                    }
+                    snprintf(value, sizeof(value), "%.15g", it->reals[row]);
+                    line.append(value);
+                    break;
+                case CGXProfileDecoder::COLUMN_RAW:
+                    if (it->raws[row].empty())
+                    {
+                        line.append("NULL");
+                        break;
+                    }
+                    CGXHex::Append((const unsigned char*)it->raws[row].data(), it->raws[row].size(), line);
+                    break;
+                default:
+                    line.append("NULL");
+                    break;
+                }
+            }
+            line.push_back('\n');
+            fwrite(line.data(), 1, line.size(), out);
+        }
+    }
+    return ret == -1 ? 0 : ret;
+}
@@ -0,0 +1,52 @@
+#ifndef GXSTORE_H
+#define GXSTORE_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "decoder.h"
+
+//Append-only store of the rows of profiles.
+//Each meter, profile and attribute is a series, a directory of its own with
+//segment files of compressed blocks and an index of the blocks. A block holds
+//the rows of one read as columns: times as delta of deltas, integers as
+//deltas, reals XOR'ed with the value before them and raw values as they are.
+//The index has a fixed size record with the time range of each block, so a
+//query maps it and reads only the blocks of its range.
+//Appends to a series are serialized with a lock on its index, appends to
+//other series don't wait.
+class CGXStore
+{
+public:
+    //Record of a block in the index of a series.
+    struct Block
+    {
+        //Capture times of the first and the last row.
+        long long first;
+        long long last;
+        //Segment file, position and size of the block.
+        unsigned int segment;
+        unsigned int offset;
+        unsigned int size;
+        unsigned int rows;
+    };
+
+    //Get the name of the series of a meter, a profile and an attribute.
+    static std::string GetSeries(const std::string& meter, const std::string& obis, int attribute);
+
+    //Append the rows of a decoder as a block of a series.
+    //Rows without a capture time get the time of the append.
+    //Returns 0 or the system error.
+    static int Append(const std::string& directory, const std::string& series, const CGXProfileDecoder& rows);
+
+    //Get the capture times of the rows of a series from from to to, inclusive, in the order they were stored.
+    //A series which is not there has no rows. Returns 0 or the system error, EINVAL if a block is damaged.
+    static int GetTimes(const std::string& directory, const std::string& series, long long from, long long to, std::vector<long long>& times);
+
+    //Write the rows of a series captured from from to to, inclusive, as text lines:
+    //the capture time and the values of the row, raw values in hex and missing values as NULL.
+    //Returns 0 or the system error, EINVAL if a block is damaged.
+    static int Query(const std::string& directory, const std::string& series, long long from, long long to, FILE* out);
+};
+
+#endif //GXSTORE_H